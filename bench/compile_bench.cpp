@@ -0,0 +1,288 @@
+#include "containers.hpp"
+#include "source_manager.hpp"
+#include "lexer.hpp"
+#include "parse_context.hpp"
+#include "thread_pool.hpp"
+#include "ast/ast_resolver.hpp"
+#include "llvm/llvm_code_gen.hpp"
+#include "parser.hpp"
+#include "program_generator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdio.h>
+#include <unistd.h>
+
+//Generates programs from min_lines to max_lines, ten times larger each step, and times every compiler phase on them
+//If the frontend scales linearly the lines/s of a phase stays the same at every size
+//
+//ToyC_bench [options]
+//  --lines=<min>,<max>   sizes to run, default 1000,1000000
+//  --runs=<n>            best of up to n runs per size, default 3
+//  --skip-compile        leave out object emission, by far the slowest phase on large inputs
+//  -O0 -O1 -O2 -O3 -Os   optimization level of the compile phase, default -O0
+//  -march=<cpu> -mcpu=<cpu> -mattr=<features>  target of the compile phase, default generic
+//  --codegen-threads=<n> emit the compile phase in n partitions on n threads
+//  -j<n>                 resolve function bodies on n threads
+//  --emit=<file>         only write one program with the settings below to file
+//  --functions=<n> --structs=<n> --parameters=<n> --depth=<n> --nesting=<n> --statements=<n> --main-calls=<n> --seed=<n>
+
+enum Phase
+{
+    Lex,
+    Parse,
+    Resolve,
+    Codegen,
+    Compile,
+    PhaseCount,
+};
+
+static const char* const phase_names[PhaseCount] = {"lex", "parse", "resolve", "codegen", "compile"};
+
+static const double max_seconds_per_size = 20.0;
+
+struct BenchOptions
+{
+    ProgramGeneratorSettings settings;
+    size_t min_lines = 1000;
+    size_t max_lines = 1000000;
+    int runs = 3;
+    bool skip_compile = false;
+    size_t thread_count = 1;
+    OptimizationLevel optimization_level = OptimizationLevel::O0;
+    CpuTarget cpu_target;
+    size_t codegen_threads = 1;
+    string emit_file;
+};
+
+static bool parse_size(const char* argument, const char* option, size_t& value)
+{
+    size_t length = strlen(option);
+    if(strncmp(argument, option, length) != 0)
+    {
+        return false;
+    }
+
+    char* end;
+    value = strtoul(argument + length, &end, 10);
+    if(end == argument + length || *end != '\0')
+    {
+        printf("Error: invalid value in %s\n", argument);
+        exit(-1);
+    }
+    return true;
+}
+
+static BenchOptions parse_arguments(int argc, char** argv)
+{
+    BenchOptions options;
+    for(int i = 1; i < argc; i++)
+    {
+        const char* argument = argv[i];
+        size_t value;
+        if(strncmp(argument, "--lines=", 8) == 0)
+        {
+            if(sscanf(argument + 8, "%zu,%zu", &options.min_lines, &options.max_lines) != 2 || options.min_lines == 0 || options.min_lines > options.max_lines)
+            {
+                printf("Error: expected --lines=<min>,<max>\n");
+                exit(-1);
+            }
+        }
+        else if(parse_size(argument, "--runs=", value))
+        {
+            options.runs = value > 0 ? (int)value : 1;
+        }
+        else if(strcmp(argument, "--skip-compile") == 0)
+        {
+            options.skip_compile = true;
+        }
+        else if(parse_size(argument, "-j", options.thread_count)) {}
+        else if(parse_optimization_level(argument, options.optimization_level)) {}
+        else if(parse_cpu_target(argument, options.cpu_target)) {}
+        else if(parse_size(argument, "--codegen-threads=", options.codegen_threads)) {}
+        else if(strncmp(argument, "--emit=", 7) == 0)
+        {
+            options.emit_file = argument + 7;
+        }
+        else if(parse_size(argument, "--functions=", options.settings.function_count)) {}
+        else if(parse_size(argument, "--structs=", options.settings.struct_count)) {}
+        else if(parse_size(argument, "--parameters=", options.settings.parameter_count)) {}
+        else if(parse_size(argument, "--depth=", options.settings.expression_depth)) {}
+        else if(parse_size(argument, "--nesting=", options.settings.nesting_depth)) {}
+        else if(parse_size(argument, "--statements=", options.settings.block_statements)) {}
+        else if(parse_size(argument, "--main-calls=", options.settings.main_calls)) {}
+        else if(parse_size(argument, "--seed=", value))
+        {
+            options.settings.seed = (uint32_t)value;
+        }
+        else
+        {
+            printf("Error: unknown option %s\n", argument);
+            exit(-1);
+        }
+    }
+    return options;
+}
+
+static bool write_file(const string& path, const string& text)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if(!file)
+    {
+        printf("Error: cannot create %s\n", path.c_str());
+        return false;
+    }
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+    return true;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+//One pass of every phase over the file, each phase works on what the last one produced
+static bool run_phases(SourceFile* file, const BenchOptions& options, ThreadPool* pool, double (&times)[PhaseCount])
+{
+    auto start = std::chrono::steady_clock::now();
+    {
+        YYSTYPE value;
+        void* scanner = lexer_create(file);
+        while(yylex(&value, scanner) != 0) {}
+        lexer_destroy(scanner);
+    }
+    times[Lex] = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    unique_ptr<Module> module_ast = parse_source_file(file);
+    times[Parse] = seconds_since(start);
+    if(!module_ast)
+    {
+        printf("Error: generated program did not parse\n");
+        return false;
+    }
+
+    start = std::chrono::steady_clock::now();
+    bool resolved = AstResolver().resolve(module_ast.get(), pool);
+    times[Resolve] = seconds_since(start);
+    if(!resolved)
+    {
+        printf("Error: generated program did not resolve\n");
+        return false;
+    }
+
+    start = std::chrono::steady_clock::now();
+    llvmModule module(file->get_path(), module_ast.get());
+    times[Codegen] = seconds_since(start);
+
+    times[Compile] = 0.0;
+    if(!options.skip_compile)
+    {
+        string object_file = file->get_path() + ".o";
+        start = std::chrono::steady_clock::now();
+        module.compile(object_file, options.optimization_level, options.codegen_threads);
+        times[Compile] = seconds_since(start);
+        unlink(object_file.c_str());
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options = parse_arguments(argc, argv);
+
+    if(!options.emit_file.empty())
+    {
+        return write_file(options.emit_file, ProgramGenerator(options.settings).generate()) ? 0 : -1;
+    }
+
+    llvmModule::initialize_targets();
+    if(!llvmModule::set_cpu_target(options.cpu_target))
+    {
+        return -1;
+    }
+    unique_ptr<ThreadPool> pool;
+    if(options.thread_count != 1)
+    {
+        pool = std::make_unique<ThreadPool>(options.thread_count);
+    }
+
+    printf("%10s %10s", "lines", "KiB");
+    for(int phase = 0; phase < PhaseCount; phase++)
+    {
+        printf(" %10s lines/s", phase_names[phase]);
+    }
+    printf("\n");
+
+    SourceManager source_manager;
+    double first_rates[PhaseCount] = {};
+    double last_rates[PhaseCount] = {};
+    for(size_t lines = options.min_lines; lines <= options.max_lines; lines *= 10)
+    {
+        ProgramGeneratorSettings settings = options.settings;
+        settings.line_count = lines;
+        string source = ProgramGenerator(settings).generate();
+
+        string path = "/tmp/toyc_bench_" + std::to_string(getpid()) + "_" + std::to_string(lines) + ".c_not";
+        if(!write_file(path, source))
+        {
+            return -1;
+        }
+        SourceFile* file = source_manager.open(path);
+        unlink(path.c_str());
+        if(!file)
+        {
+            return -1;
+        }
+
+        //Large sizes take minutes per run, so runs stop repeating once a size has had its time
+        double best[PhaseCount];
+        std::fill(best, best + PhaseCount, 1e30);
+        auto size_start = std::chrono::steady_clock::now();
+        for(int run = 0; run < options.runs && (run == 0 || seconds_since(size_start) < max_seconds_per_size); run++)
+        {
+            double times[PhaseCount];
+            if(!run_phases(file, options, pool.get(), times))
+            {
+                return -1;
+            }
+            for(int phase = 0; phase < PhaseCount; phase++)
+            {
+                best[phase] = std::min(best[phase], times[phase]);
+            }
+        }
+
+        //Generation stops at the end of a function, so the real line count is a little over the target
+        size_t real_lines = std::count(source.begin(), source.end(), '\n');
+        printf("%10zu %10.1f", real_lines, (double)source.size() / 1024.0);
+        for(int phase = 0; phase < PhaseCount; phase++)
+        {
+            last_rates[phase] = best[phase] > 0.0 ? real_lines / best[phase] : 0.0;
+            if(lines == options.min_lines)
+            {
+                first_rates[phase] = last_rates[phase];
+            }
+            printf(" %18.0f", last_rates[phase]);
+        }
+        printf("\n");
+        fflush(stdout);
+
+        if(lines > options.max_lines / 10)
+        {
+            break;
+        }
+    }
+
+    //Close to 1.00 means linear, lower means the phase slows down per line as the input grows
+    printf("%21s", "largest/smallest");
+    for(int phase = 0; phase < PhaseCount; phase++)
+    {
+        printf(" %18.2f", first_rates[phase] > 0.0 ? last_rates[phase] / first_rates[phase] : 0.0);
+    }
+    printf("\n");
+
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include "containers.hpp"
+#include "source_manager.hpp"
+#include "lexer.hpp"
+#include "ast/module.hpp"
+#include "parser.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <stdio.h>
+#include <unistd.h>
+
+//Writes a source file of roughly target_bytes made of functions shaped like test.c_not
+static string generate_source(size_t target_bytes)
+{
+    string path = "/tmp/toyc_lexer_bench_" + std::to_string(getpid()) + ".c_not";
+    FILE* file = fopen(path.c_str(), "w");
+    if(!file)
+    {
+        printf("Error: cannot create %s\n", path.c_str());
+        exit(-1);
+    }
+
+    fprintf(file, "void print_i32(i32 value);\n\nstruct StructType\n{\n    i32 value1;\n    i64 value2;\n    bool value3;\n}\n\n");
+
+    size_t written = 0;
+    for(size_t i = 0; written < target_bytes; i++)
+    {
+        written += fprintf(file,
+                "i32 function_%zu(i32 first_value, i32 second_value)\n"
+                "{\n"
+                "    i32 value = -3;\n"
+                "    f64 scale = 1.25;\n"
+                "    value = (first_value + second_value * %zu) / 7 - value %% 3;\n"
+                "    if(value)\n"
+                "    {\n"
+                "        print_i32(value);\n"
+                "    }\n"
+                "    return value + function_%zu(value, 2);\n"
+                "}\n\n", i, i, i / 2);
+    }
+
+    fclose(file);
+    return path;
+}
+
+struct Token
+{
+    int token;
+    long value;
+};
+
+template<typename Function>
+static double time_best_of(int runs, Function function)
+{
+    double best = 1e30;
+    for(int i = 0; i < runs; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = elapsed.count() < best ? elapsed.count() : best;
+    }
+    return best;
+}
+
+static long token_value(int token, const YYSTYPE& value)
+{
+    switch (token)
+    {
+        case INTEGER:
+            return value.int_val;
+        case IDENTIFIER:
+            return value.string_id;
+        case FLOAT:
+        {
+            long bits;
+            memcpy(&bits, &value.double_val, sizeof(bits));
+            return bits;
+        }
+        default:
+            return 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const int runs = 5;
+
+    //--check only compares the token streams, which is what the lexer test runs
+    vector<string> file_names;
+    string generated_file;
+    bool check_only = false;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--check") == 0)
+        {
+            check_only = true;
+            continue;
+        }
+        file_names.push_back(argv[i]);
+    }
+    if(file_names.empty())
+    {
+        generated_file = generate_source(64 * 1024 * 1024);
+        file_names.push_back(generated_file);
+    }
+
+    SourceManager source_manager;
+    int result = 0;
+    for(const string& file_name: file_names)
+    {
+        SourceFile* file = source_manager.open(file_name);
+        if(!file)
+        {
+            return -1;
+        }
+
+        //Check both scanners agree before timing anything
+        vector<Token> flex_tokens;
+        YYSTYPE flex_value;
+        void* scanner = lexer_create(file);
+        for(int token = yylex(&flex_value, scanner); token != 0; token = yylex(&flex_value, scanner))
+        {
+            flex_tokens.push_back({token, token_value(token, flex_value)});
+        }
+        lexer_destroy(scanner);
+
+        vector<Token> simd_tokens;
+        Lexer lexer;
+        YYSTYPE value;
+        lexer.begin(file);
+        for(int token = lexer.next_token(&value); token != 0; token = lexer.next_token(&value))
+        {
+            simd_tokens.push_back({token, token_value(token, value)});
+        }
+
+        size_t mismatch = 0;
+        while(mismatch < flex_tokens.size() && mismatch < simd_tokens.size()
+            && flex_tokens[mismatch].token == simd_tokens[mismatch].token && flex_tokens[mismatch].value == simd_tokens[mismatch].value)
+        {
+            mismatch++;
+        }
+        if(mismatch != flex_tokens.size() || mismatch != simd_tokens.size())
+        {
+            printf("%s: token streams differ at token %zu (flex %zu tokens, simd %zu tokens)\n", file_name.c_str(), mismatch, flex_tokens.size(), simd_tokens.size());
+            result = 1;
+            continue;
+        }
+        if(check_only)
+        {
+            printf("%s: %zu tokens match\n", file_name.c_str(), flex_tokens.size());
+            continue;
+        }
+
+        double flex_time = time_best_of(runs, [&]()
+        {
+            YYSTYPE value;
+            void* scanner = lexer_create(file);
+            while(yylex(&value, scanner) != 0) {}
+            lexer_destroy(scanner);
+        });
+
+        double simd_time = time_best_of(runs, [&]()
+        {
+            Lexer lexer;
+            YYSTYPE value;
+            lexer.begin(file);
+            while(lexer.next_token(&value) != 0) {}
+        });
+
+        double megabytes = (double)file->get_size() / (1024.0 * 1024.0);
+        printf("%s: %.1f MiB, %zu tokens\n", file_name.c_str(), megabytes, flex_tokens.size());
+        printf("    flex: %8.2f ms %8.1f MiB/s\n", flex_time * 1000.0, megabytes / flex_time);
+        printf("    simd: %8.2f ms %8.1f MiB/s (%.2fx)\n", simd_time * 1000.0, megabytes / simd_time, flex_time / simd_time);
+    }
+
+    if(!generated_file.empty())
+    {
+        unlink(generated_file.c_str());
+    }
+
+    return result;
+}
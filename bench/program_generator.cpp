@@ -0,0 +1,266 @@
+#include "program_generator.hpp"
+
+//Calls only go this far back, so a call is as likely to be near as far in a large program
+static const size_t max_call_distance = 16;
+
+ProgramGenerator::ProgramGenerator(const ProgramGeneratorSettings& settings)
+:settings(settings)
+{
+}
+
+string ProgramGenerator::generate()
+{
+    this->random.seed(this->settings.seed);
+    this->output.clear();
+    this->lines = 0;
+    this->next_variable = 0;
+    this->functions.clear();
+    this->variables.clear();
+
+    this->write_line(0, "void print_i32(i32 value);");
+    this->write_line(0, "void print_i64(i64 value);");
+    this->write_line(0, "");
+
+    for(size_t i = 0; i < this->settings.struct_count; i++)
+    {
+        this->generate_struct(i);
+    }
+
+    for(size_t i = 0; this->settings.line_count != 0 ? this->lines < this->settings.line_count : i < this->settings.function_count; i++)
+    {
+        this->generate_function(i);
+    }
+    this->generate_main();
+
+    return std::move(this->output);
+}
+
+size_t ProgramGenerator::random_below(size_t limit)
+{
+    return std::uniform_int_distribution<size_t>(0, limit - 1)(this->random);
+}
+
+ProgramGenerator::ValueType ProgramGenerator::random_type()
+{
+    //Mostly i32 so most expressions can contain calls
+    switch (this->random_below(4))
+    {
+        case 0:
+            return ValueType::I64;
+        case 1:
+            return ValueType::F64;
+        default:
+            return ValueType::I32;
+    }
+}
+
+void ProgramGenerator::write_line(size_t indent, const string& line)
+{
+    this->output.append(indent * 4, ' ');
+    this->output += line;
+    this->output += '\n';
+    this->lines++;
+}
+
+void ProgramGenerator::generate_struct(size_t index)
+{
+    this->write_line(0, "struct Struct" + std::to_string(index));
+    this->write_line(0, "{");
+    size_t member_count = 1 + this->random_below(6);
+    for(size_t i = 0; i < member_count; i++)
+    {
+        this->write_line(1, string(get_type_name(this->random_type())) + " member" + std::to_string(i) + ";");
+    }
+    this->write_line(0, "}");
+    this->write_line(0, "");
+}
+
+void ProgramGenerator::generate_function(size_t index)
+{
+    FunctionSignature function;
+    function.id = index;
+    this->body_cost = 0;
+
+    string header = "i32 function" + std::to_string(index) + "(";
+    size_t parameter_count = this->random_below(this->settings.parameter_count + 1);
+    for(size_t i = 0; i < parameter_count; i++)
+    {
+        ValueType type = this->random_type();
+        size_t id = this->next_variable++;
+        function.parameters.push_back(type);
+        this->variables.push_back({id, type});
+        header += (i == 0 ? "" : ", ") + string(get_type_name(type)) + " value" + std::to_string(id);
+    }
+    header += ")";
+
+    this->write_line(0, header);
+    this->write_line(0, "{");
+    for(size_t i = 0; i < this->settings.block_statements; i++)
+    {
+        this->generate_statement(1, 0);
+    }
+    this->write_line(1, "return " + this->generate_expression(ValueType::I32, this->settings.expression_depth) + ";");
+    this->write_line(0, "}");
+    this->write_line(0, "");
+
+    //Added after the body so a function never calls itself
+    function.cost = 1 + this->body_cost;
+    this->variables.clear();
+    this->functions.push_back(std::move(function));
+}
+
+void ProgramGenerator::generate_main()
+{
+    this->write_line(0, "i32 main()");
+    this->write_line(0, "{");
+    this->body_cost = 0;
+    size_t call_count = std::min(this->settings.main_calls, this->functions.size());
+    for(size_t i = 0; i < call_count; i++)
+    {
+        const FunctionSignature& function = this->functions[(i + 1) * this->functions.size() / call_count - 1];
+        this->write_line(1, "print_i32(" + this->generate_call(function) + ");");
+    }
+    this->write_line(1, "return 0;");
+    this->write_line(0, "}");
+}
+
+void ProgramGenerator::generate_block(size_t indent, size_t nesting)
+{
+    size_t visible = this->variables.size();
+    this->write_line(indent - 1, "{");
+    for(size_t i = 0; i < this->settings.block_statements; i++)
+    {
+        this->generate_statement(indent, nesting);
+    }
+    this->write_line(indent - 1, "}");
+    this->variables.resize(visible);
+}
+
+void ProgramGenerator::generate_statement(size_t indent, size_t nesting)
+{
+    size_t choice = this->random_below(10);
+    if(choice < 2 && nesting < this->settings.nesting_depth)
+    {
+        this->write_line(indent, "if(" + this->generate_expression(ValueType::I32, this->settings.expression_depth) + ")");
+        this->generate_block(indent + 1, nesting + 1);
+        if(this->random_below(2) == 0)
+        {
+            this->write_line(indent, "else");
+            this->generate_block(indent + 1, nesting + 1);
+        }
+        return;
+    }
+
+    if(choice < 4 && !this->variables.empty())
+    {
+        const Variable& variable = this->variables[this->random_below(this->variables.size())];
+        this->write_line(indent, "value" + std::to_string(variable.id) + " = " + this->generate_expression(variable.type, this->settings.expression_depth) + ";");
+        return;
+    }
+
+    if(choice == 4)
+    {
+        ValueType type = this->random_below(2) == 0 ? ValueType::I32 : ValueType::I64;
+        this->write_line(indent, string(type == ValueType::I32 ? "print_i32(" : "print_i64(") + this->generate_expression(type, 1) + ");");
+        return;
+    }
+
+    const FunctionSignature* callee = choice == 5 ? this->pick_callee() : nullptr;
+    if(callee != nullptr)
+    {
+        this->write_line(indent, this->generate_call(*callee) + ";");
+        return;
+    }
+
+    ValueType type = this->random_type();
+    string initialiser = this->generate_expression(type, this->settings.expression_depth);
+    Variable variable = {this->next_variable++, type};
+    this->write_line(indent, string(get_type_name(type)) + " value" + std::to_string(variable.id) + " = " + initialiser + ";");
+    this->variables.push_back(variable);
+}
+
+string ProgramGenerator::generate_expression(ValueType type, size_t depth)
+{
+    static const char* const operators[] = {" + ", " - ", " * ", " / ", " % "};
+
+    if(depth > 0 && this->random_below(4) != 0)
+    {
+        size_t op = this->random_below(5);
+        string lhs = this->generate_expression(type, depth - 1);
+
+        //Dividing by a non zero constant keeps the programs safe to run
+        string rhs = op >= 3 ? std::to_string(1 + this->random_below(9)) + (type == ValueType::F64 ? ".5" : "") : this->generate_expression(type, depth - 1);
+        return "(" + lhs + operators[op] + rhs + ")";
+    }
+
+    size_t choice = this->random_below(8);
+    const FunctionSignature* callee = choice == 0 && type == ValueType::I32 ? this->pick_callee() : nullptr;
+    if(callee != nullptr)
+    {
+        return this->generate_call(*callee);
+    }
+
+    if(choice < 5)
+    {
+        //Pick a random variable of the right type, searching forward from a random start
+        size_t count = this->variables.size();
+        size_t start = count > 0 ? this->random_below(count) : 0;
+        for(size_t i = 0; i < count; i++)
+        {
+            const Variable& variable = this->variables[(start + i) % count];
+            if(variable.type == type)
+            {
+                return "value" + std::to_string(variable.id);
+            }
+        }
+    }
+
+    //The lexer reads a leading minus as part of a literal, so literals stay positive
+    string literal = std::to_string(this->random_below(100));
+    if(type == ValueType::F64)
+    {
+        literal += "." + std::to_string(this->random_below(10));
+    }
+    return literal;
+}
+
+//A recent function, or nullptr when there is none or calling it would go over the call budget
+const ProgramGenerator::FunctionSignature* ProgramGenerator::pick_callee()
+{
+    if(this->functions.empty())
+    {
+        return nullptr;
+    }
+
+    const FunctionSignature& function = this->functions[this->functions.size() - 1 - this->random_below(std::min(this->functions.size(), max_call_distance))];
+    if(this->body_cost + function.cost > this->settings.call_budget)
+    {
+        return nullptr;
+    }
+    this->body_cost += function.cost;
+    return &function;
+}
+
+string ProgramGenerator::generate_call(const FunctionSignature& function)
+{
+    string call = "function" + std::to_string(function.id) + "(";
+    for(size_t i = 0; i < function.parameters.size(); i++)
+    {
+        call += (i == 0 ? "" : ", ") + this->generate_expression(function.parameters[i], 1);
+    }
+    return call + ")";
+}
+
+const char* ProgramGenerator::get_type_name(ValueType type)
+{
+    switch (type)
+    {
+        case ValueType::I32:
+            return "i32";
+        case ValueType::I64:
+            return "i64";
+        case ValueType::F64:
+            return "f64";
+    }
+    return "";
+}
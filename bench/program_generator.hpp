@@ -0,0 +1,97 @@
+#pragma once
+
+#include "containers.hpp"
+
+#include <random>
+
+struct ProgramGeneratorSettings
+{
+    uint32_t seed = 1;
+
+    //Functions are added until there are function_count of them, or until the program has line_count lines when that is set
+    size_t function_count = 100;
+    size_t line_count = 0;
+
+    size_t struct_count = 4;
+
+    //Most parameters a function gets, each function picks between 0 and this many
+    size_t parameter_count = 3;
+
+    //Deepest binary operator tree in one expression
+    size_t expression_depth = 3;
+
+    //Deepest if/else nesting in one function body, and statements in each block
+    size_t nesting_depth = 2;
+    size_t block_statements = 4;
+
+    //Functions main calls and prints the result of, spread evenly over the program and always including the last one
+    size_t main_calls = 16;
+
+    //Most function calls that one call may lead to, counting both sides of every if, calls chaining back through the program grow exponentially otherwise
+    size_t call_budget = 10000;
+};
+
+//Writes random ToyC programs that parse, resolve and compile without errors
+//They end with an i32 main(), so they link and run and their output can be compared between compile options
+//Only uses what the grammar has, so every variable is initialised, types never mix and calls only go to earlier functions
+//The same settings and seed always give the same program
+class ProgramGenerator
+{
+public:
+    ProgramGenerator(const ProgramGeneratorSettings& settings);
+
+    string generate();
+
+protected:
+    enum class ValueType
+    {
+        I32,
+        I64,
+        F64,
+    };
+
+    struct Variable
+    {
+        size_t id;
+        ValueType type;
+    };
+
+    struct FunctionSignature
+    {
+        size_t id;
+        vector<ValueType> parameters;
+
+        //Calls one call of this function makes at most, itself included
+        size_t cost;
+    };
+
+    ProgramGeneratorSettings settings;
+    std::mt19937 random;
+    string output;
+    size_t lines = 0;
+    size_t next_variable = 0;
+
+    vector<FunctionSignature> functions;
+
+    //Cost of the calls in the body being written so far
+    size_t body_cost = 0;
+
+    //Variables visible at the current point, a block truncates it back when it closes
+    vector<Variable> variables;
+
+    size_t random_below(size_t limit);
+    ValueType random_type();
+
+    void write_line(size_t indent, const string& line);
+
+    void generate_struct(size_t index);
+    void generate_function(size_t index);
+    void generate_main();
+    void generate_block(size_t indent, size_t nesting);
+    void generate_statement(size_t indent, size_t nesting);
+    string generate_expression(ValueType type, size_t depth);
+    const FunctionSignature* pick_callee();
+    string generate_call(const FunctionSignature& function);
+
+    static const char* get_type_name(ValueType type);
+};
@@ -0,0 +1,21 @@
+void print_i32(int value);
+
+//Deep non tail recursion with two arguments, stresses calls and the stack
+int ackermann(int m, int n)
+{
+    if(m)
+    {
+        if(n)
+        {
+            return ackermann(m - 1, ackermann(m, n - 1));
+        }
+        return ackermann(m - 1, 1);
+    }
+    return n + 1;
+}
+
+int main()
+{
+    print_i32(ackermann(3, 11));
+    return 0;
+}
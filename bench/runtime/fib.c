@@ -0,0 +1,17 @@
+void print_i32(int value);
+
+//Naive recursion, measures call overhead and the n / 2 base case check
+int fib(int n)
+{
+    if(n / 2)
+    {
+        return fib(n - 1) + fib(n - 2);
+    }
+    return n;
+}
+
+int main()
+{
+    print_i32(fib(38));
+    return 0;
+}
@@ -0,0 +1,54 @@
+void print_f64(double value);
+
+//Midpoint style integration of x^2 / (1.5 + x), then Newton's method square roots, both f64 multiply, add and divide chains
+double integrate_loop(int i, double x, double sum)
+{
+    if(i)
+    {
+        return integrate_loop(i - 1, x + 0.0001, sum + x * x / (1.5 + x));
+    }
+    return sum;
+}
+
+double outer_loop(int n, double sum)
+{
+    if(n)
+    {
+        return outer_loop(n - 1, sum + integrate_loop(10000, 0.0, 0.0) * 0.0001);
+    }
+    return sum;
+}
+
+double newton_sqrt(int steps, double value, double guess)
+{
+    if(steps)
+    {
+        return newton_sqrt(steps - 1, value, (guess + value / guess) * 0.5);
+    }
+    return guess;
+}
+
+double sqrt_loop(int n, double x, double sum)
+{
+    if(n)
+    {
+        return sqrt_loop(n - 1, x + 1.0, sum + newton_sqrt(20, x, 1.0));
+    }
+    return sum;
+}
+
+double sqrt_outer_loop(int n, double sum)
+{
+    if(n)
+    {
+        return sqrt_outer_loop(n - 1, sum + sqrt_loop(1000, 2.0, 0.0) * 0.001);
+    }
+    return sum;
+}
+
+int main()
+{
+    print_f64(outer_loop(2000, 0.0));
+    print_f64(sqrt_outer_loop(200, 0.0));
+    return 0;
+}
@@ -0,0 +1,46 @@
+void print_i32(int value);
+
+//Loops are written as recursion of bounded depth, which is what ToyC had when this kernel was written, loops.c measures real loops
+//A multiply, add and modulo hash chain, then Euclid's gcd which is dominated by division
+int hash_loop(int i, int hash)
+{
+    if(i)
+    {
+        return hash_loop(i - 1, (hash * 31 + i) % 1000003);
+    }
+    return hash;
+}
+
+int outer_loop(int n, int hash)
+{
+    if(n)
+    {
+        return outer_loop(n - 1, hash_loop(1000, hash + n));
+    }
+    return hash;
+}
+
+int gcd(int a, int b)
+{
+    if(b)
+    {
+        return gcd(b, a % b);
+    }
+    return a;
+}
+
+int gcd_loop(int n, int sum)
+{
+    if(n)
+    {
+        return gcd_loop(n - 1, sum + gcd(n * 7919, 104729 + n));
+    }
+    return sum;
+}
+
+int main()
+{
+    print_i32(outer_loop(20000, 1));
+    print_i32(gcd_loop(50000, 0));
+    return 0;
+}
@@ -0,0 +1,70 @@
+void print_i32(int value);
+
+//for, while and do while with break and continue, the shapes LLVM's loop passes start from
+//Trial division where break leaves at the first divisor and continue skips even numbers
+int count_primes(int limit)
+{
+    int count = 1;
+    for(int n = 3; n < limit; n = n + 1)
+    {
+        if(n % 2 == 0)
+        {
+            continue;
+        }
+        int prime = 1;
+        for(int d = 3; d * d <= n; d = d + 2)
+        {
+            if(n % d == 0)
+            {
+                prime = 0;
+                break;
+            }
+        }
+        count = count + prime;
+    }
+    return count;
+}
+
+//A data dependent do while nested in a while, values stay below 2^31 for starts under 100000
+int collatz_steps(int limit)
+{
+    int total = 0;
+    int start = 1;
+    while(start < limit)
+    {
+        int value = start;
+        do
+        {
+            if(value % 2 == 0)
+            {
+                value = value / 2;
+            }
+            else
+            {
+                value = value * 3 + 1;
+            }
+            total = total + 1;
+        } while(value != 1);
+        start = start + 1;
+    }
+    return total;
+}
+
+//A reduction the ToyC version marks @vectorize(4) @unroll(2), integer sums come out the same in any order
+int mod_sum(int n)
+{
+    int sum = 0;
+    for(int i = 0; i < n; i = i + 1)
+    {
+        sum = sum + i * 3 % 11;
+    }
+    return sum;
+}
+
+int main()
+{
+    print_i32(count_primes(1000000));
+    print_i32(collatz_steps(100000));
+    print_i32(mod_sum(100000000));
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "containers.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdio.h>
+
+//Runs every ToyC kernel and the same program written in C, checks they print the same and reports how much slower ToyC is
+//
+//ToyC_runtime_compare [--runs=<n>] <name> <toyc program> <c program> ...
+
+struct RunResult
+{
+    double seconds;
+    string output;
+    bool succeeded;
+};
+
+static RunResult run_program(const string& program)
+{
+    RunResult result = {0.0, "", false};
+
+    auto start = std::chrono::steady_clock::now();
+    FILE* pipe = popen(program.c_str(), "r");
+    if(!pipe)
+    {
+        return result;
+    }
+
+    char buffer[4096];
+    size_t read;
+    while((read = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+    {
+        result.output.append(buffer, read);
+    }
+    int status = pclose(pipe);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.seconds = elapsed.count();
+    result.succeeded = status == 0;
+    return result;
+}
+
+//Best of runs, so a busy machine only makes the numbers noisier and not wrong in one direction
+static bool time_program(const string& program, int runs, double& best, string& output)
+{
+    best = 1e30;
+    for(int i = 0; i < runs; i++)
+    {
+        RunResult result = run_program(program);
+        if(!result.succeeded)
+        {
+            printf("Error: %s failed\n", program.c_str());
+            return false;
+        }
+        best = result.seconds < best ? result.seconds : best;
+        output = result.output;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int runs = 5;
+    int first = 1;
+    if(argc > 1 && strncmp(argv[1], "--runs=", 7) == 0)
+    {
+        runs = atoi(argv[1] + 7) > 0 ? atoi(argv[1] + 7) : 1;
+        first = 2;
+    }
+
+    if((argc - first) % 3 != 0 || argc == first)
+    {
+        printf("Usage: %s [--runs=<n>] <name> <toyc program> <c program> ...\n", argv[0]);
+        return -1;
+    }
+
+    printf("%-16s %12s %12s %8s\n", "kernel", "toyc ms", "c ms", "ratio");
+
+    int result = 0;
+    double log_ratio_sum = 0.0;
+    int kernel_count = 0;
+    for(int i = first; i < argc; i += 3)
+    {
+        const char* name = argv[i];
+        double toyc_time, c_time;
+        string toyc_output, c_output;
+        if(!time_program(argv[i + 1], runs, toyc_time, toyc_output) || !time_program(argv[i + 2], runs, c_time, c_output))
+        {
+            result = 1;
+            continue;
+        }
+
+        //A fast but wrong kernel is a codegen bug, not a win
+        if(toyc_output != c_output)
+        {
+            printf("%-16s output differs from C\n    toyc: %s    c:    %s", name, toyc_output.c_str(), c_output.c_str());
+            result = 1;
+            continue;
+        }
+
+        double ratio = toyc_time / c_time;
+        printf("%-16s %12.2f %12.2f %7.2fx\n", name, toyc_time * 1000.0, c_time * 1000.0, ratio);
+        log_ratio_sum += std::log(ratio);
+        kernel_count++;
+    }
+
+    if(kernel_count > 0)
+    {
+        printf("%-16s %12s %12s %7.2fx\n", "geometric mean", "", "", std::exp(log_ratio_sum / kernel_count));
+    }
+    return result;
+}
@@ -23,4 +23,8 @@ void print_u64(int value)
 void print_str(char* value)
 {
     printf("string: %s\n", value);
-}
\ No newline at end of file
+}
+void print_f64(double value)
+{
+    printf("F64: %f\n", value);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "containers.hpp"
+
+#include <memory_resource>
+#include <type_traits>
+
+//Bump allocator that owns everything created in it, memory is released all at once when the arena is destroyed
+//Containers that should live in the arena take get_resource() as their allocator, they can then be moved between objects in the arena without copying
+class Arena
+{
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena()
+    {
+        this->release();
+    };
+
+    template<typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        void* memory = this->resource.allocate(sizeof(T), alignof(T));
+        T* object = new(memory) T(std::forward<Args>(args)...);
+
+        //Only objects that hold something outside the arena need their destructor run
+        if(!std::is_trivially_destructible<T>::value)
+        {
+            this->destructors.push_back({object, [](void* pointer) { ((T*)pointer)->~T(); }});
+        }
+        return object;
+    };
+
+    std::pmr::memory_resource* get_resource() { return &this->resource; };
+
+    //Destroys everything created so far and gives the memory back, nothing from before may be used afterwards
+    void release()
+    {
+        for(size_t i = this->destructors.size(); i > 0; i--)
+        {
+            this->destructors[i - 1].destroy(this->destructors[i - 1].object);
+        }
+        this->destructors.clear();
+        this->resource.release();
+    };
+
+protected:
+    struct Destructor
+    {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    std::pmr::monotonic_buffer_resource resource;
+    vector<Destructor> destructors;
+};
@@ -1,17 +1,28 @@
 #include "ast_resolver.hpp"
 
-void GlobalScope::add_function(const string &name, const FunctionType& function_type)
+#include <cstdarg>
+
+[[noreturn]] static void fail(const char* format, ...)
+{
+    char message[1024];
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(message, sizeof(message), format, arguments);
+    va_end(arguments);
+    throw ResolveError{message};
+}
+
+void GlobalScope::add_function(StringId name, const FunctionType& function_type)
 {
     if(this->functions_types.find(name) != this->functions_types.end())
     {
-        printf("Error: Function %s redefined\n", name.c_str());
-        exit(-1);
+        fail("Error: Function %s redefined\n", StringCache::c_str(name));
     }
 
     this->functions_types[name] = function_type;
 }
 
-FunctionType GlobalScope::get_function_type(const string &name)
+const FunctionType& GlobalScope::get_function_type(StringId name) const
 {
     auto find_it = this->functions_types.find(name);
     if(find_it != this->functions_types.end())
@@ -19,374 +30,529 @@ FunctionType GlobalScope::get_function_type(const string &name)
         return find_it->second;
     }
 
-    printf("Error: No variable with name %s \n", name.c_str());
-    exit(-1);
+    char message[1024];
+    snprintf(message, sizeof(message), "Error: No variable with name %s \n", StringCache::c_str(name));
+    throw ResolveError{message, true};
 }
 
-LocalScope::LocalScope(LocalScope *parent_scope, GlobalScope* global_scope)
-:parent_scope(parent_scope)
+LocalScope::LocalScope(const GlobalScope* global_scope)
+:global_scope(global_scope)
 {
-    if(parent_scope != nullptr)
-    {
-        this->global_scope = parent_scope->global_scope;
-    }
-    else
-    {
-        this->global_scope = global_scope;
-    }
 }
 
-void LocalScope::add_variable(const string &name, shared_ptr<Type> variable_type)
+void LocalScope::add_variable(StringId name, TypeId variable_type)
 {
-    if(this->variable_types.find(name) != this->variable_types.end())
+    if(!this->variables.add(name, variable_type))
     {
-        printf("Error: Variable %s redefined\n", name.c_str());
-        exit(-1);
+        fail("Error: Variable %s redefined\n", StringCache::c_str(name));
     }
-
-    this->variable_types[name] = variable_type;
 }
 
-shared_ptr<Type> LocalScope::get_variable_type(const string &name)
+TypeId LocalScope::get_variable_type(StringId name)
 {
-    auto find_it = this->variable_types.find(name);
-    if(find_it != this->variable_types.end())
+    TypeId* variable_type = this->variables.find(name);
+    if(variable_type != nullptr)
     {
-        return find_it->second;
-    }
-    else
-    {
-        if(this->parent_scope != nullptr)
-        {
-            return this->parent_scope->get_variable_type(name);
-        }
+        return *variable_type;
     }
 
-    printf("Error: No variable with name %s \n", name.c_str());
-    exit(-1);
+    fail("Error: No variable with name %s \n", StringCache::c_str(name));
 }
 
-FunctionType LocalScope::get_function_type(const string &name)
+const FunctionType& LocalScope::get_function_type(StringId name)
 {
     return this->global_scope->get_function_type(name);
 }
 
-AstResolver::AstResolver()
+AstResolver::AstResolver(TimeReport* time_report, CompileStats* stats)
+:time_report(time_report), stats(stats)
 {
-    //Add Primitive Types
-    this->type_map["void"] = std::make_shared<VoidType>();
-    this->type_map["bool"] = std::make_shared<IntType>(TypeEnum::Bool);
-    this->type_map["char"] = std::make_shared<IntType>(TypeEnum::Char8);
-    this->type_map["u8"] = std::make_shared<IntType>(TypeEnum::Uint8);
-    this->type_map["u16"] = std::make_shared<IntType>(TypeEnum::Uint16);
-    this->type_map["u32"] = std::make_shared<IntType>(TypeEnum::Uint32);
-    this->type_map["u64"] = std::make_shared<IntType>(TypeEnum::Uint64);
-    this->type_map["i8"] = std::make_shared<IntType>(TypeEnum::Int8);
-    this->type_map["i16"] = std::make_shared<IntType>(TypeEnum::Int16);
-    this->type_map["i32"] = std::make_shared<IntType>(TypeEnum::Int32);
-    this->type_map["i64"] = std::make_shared<IntType>(TypeEnum::Int64);
-    this->type_map["f32"] = std::make_shared<FloatType>(true);
-    this->type_map["f64"] = std::make_shared<FloatType>(false);
+    //Primitive types are found by the name they are written with
+    for(TypeId id = 1; id < TypeTable::count; id++)
+    {
+        this->type_map[StringCache::add(TypeTable::get(id).name)] = id;
+    }
 }
 
 //This (admittedly poorly named) function will process the whole module and remove any ambiguity from the AST.
 //Most notably this function will determine the appropriate Bin Op to use
-void AstResolver::resolve(Module* module)
+bool AstResolver::resolve(Module* module, ThreadPool* thread_pool)
 {
-    GlobalScope global_scope;
+    this->module = module;
 
-    for(auto& struct_object: module->structs)
+    try
     {
-        this->resolve_types_struct(struct_object);
-    }
+        {
+            TimeReport::Timer timer(this->time_report, "structs");
+            for(Struct& struct_object: module->structs)
+            {
+                this->resolve_types_struct(struct_object);
+            }
+        }
+
+        {
+            TimeReport::Timer timer(this->time_report, "externs");
+            for(ExternFunction& function: module->extern_functions)
+            {
+                this->resolve_types_extern(function, &this->global_scope);
+            }
+        }
 
-    for(auto& function: module->extern_functions)
+        {
+            TimeReport::Timer timer(this->time_report, "prototypes");
+            for(Function& function: module->functions)
+            {
+                this->resolve_types_function(function, &this->global_scope);
+            }
+        }
+    }
+    catch(const ResolveError& error)
     {
-        this->resolve_types_extern(function, &global_scope);
+        printf("%s", error.message.c_str());
+        return false;
     }
 
-    for(auto& function: module->functions)
+    //From here on global_scope, type_map and the signatures are only read, each body only writes its own nodes
+    TimeReport::Timer timer(this->time_report, "bodies");
+    vector<string> errors(module->functions.size());
+    size_t function_count = module->functions.size();
+    if(thread_pool == nullptr || function_count < 2)
     {
-        this->resolve_types_function(function, &global_scope);
+        this->resolve_types_function_blocks(0, function_count, &this->global_scope, errors);
+    }
+    else
+    {
+        //A few batches per thread keeps the queue short while still balancing uneven bodies
+        size_t batch_count = std::min(function_count, thread_pool->get_thread_count() * 4);
+        for(size_t batch = 0; batch < batch_count; batch++)
+        {
+            size_t first = function_count * batch / batch_count;
+            size_t last = function_count * (batch + 1) / batch_count;
+            thread_pool->add_job([this, first, last, &errors]()
+            {
+                double wall_start = TimeReport::get_wall_time();
+                double cpu_start = TimeReport::get_cpu_time();
+                this->resolve_types_function_blocks(first, last, &this->global_scope, errors);
+                if(this->time_report != nullptr)
+                {
+                    this->time_report->add("worker threads", TimeReport::get_wall_time() - wall_start, TimeReport::get_cpu_time() - cpu_start);
+                }
+            });
+        }
+        thread_pool->wait();
     }
 
-    for(auto& function: module->functions)
+    bool succeeded = true;
+    for(const string& error: errors)
     {
-        this->resolve_types_function_block(function, &global_scope);
+        if(!error.empty())
+        {
+            printf("%s", error.c_str());
+            succeeded = false;
+        }
     }
 
     //TODO process condition expressions to create required casting/comparisons for If/Loop statements
+    return succeeded;
 }
 
-void AstResolver::resolve_types_struct(unique_ptr<Struct> &struct_object)
+void AstResolver::resolve_types_function_blocks(size_t first, size_t last, const GlobalScope* global_scope, vector<string>& errors)
 {
-    printf("Struct Type: %s\n", struct_object->name.c_str());
+    for(size_t i = first; i < last; i++)
+    {
+        try
+        {
+            this->resolve_types_function_block(this->module->functions[i], global_scope);
+        }
+        catch(const ResolveError& error)
+        {
+            errors[i] = error.message;
+        }
+    }
+}
 
-    for(size_t i = 0; i < struct_object->members.size(); i++)
+void AstResolver::resolve_types_struct(Struct& struct_object)
+{
+    //Names share type_map with the primitives, a struct can't shadow one or be declared twice
+    if(this->type_map.find(struct_object.name) != this->type_map.end())
     {
-        struct_object->members[i].type = this->resolve_type(struct_object->members[i].type);
+        fail("Error: redefinition of type %s\n", StringCache::c_str(struct_object.name));
     }
+
+    vector<TypeId> fields;
+    for(StructMember& member: this->module->get_list(struct_object.members))
+    {
+        member.type = this->resolve_type(member.type);
+        if(TypeTable::get_class(member.type) == TypeClass::Invalid)
+        {
+            fail("Error: member %s of %s cannot be %s\n", StringCache::c_str(member.name), StringCache::c_str(struct_object.name), TypeTable::get(member.type).name);
+        }
+        fields.push_back(member.type);
+    }
+
+    struct_object.type = TypeTable::add_struct(struct_object.name, fields);
+    this->type_map[struct_object.name] = struct_object.type;
 }
 
-void AstResolver::resolve_types_extern(unique_ptr<ExternFunction>& function, GlobalScope* global_scope)
+void AstResolver::resolve_types_extern(ExternFunction& function, GlobalScope* global_scope)
 {
     FunctionType function_type;
 
-    function->return_type = this->resolve_type(function->return_type);
-    function_type.return_type = function->return_type;
+    function.return_type = this->resolve_type(function.return_type);
+    function_type.return_type = function.return_type;
 
-    for(size_t i = 0; i < function->parameters.size(); i++)
+    for(FunctionParameter& parameter: this->module->get_list(function.parameters))
     {
-        function->parameters[i].type = this->resolve_type(function->parameters[i].type);
-        function_type.arguments.push_back(function->parameters[i].type);
+        parameter.type = this->resolve_type(parameter.type);
+        function_type.arguments.push_back(parameter.type);
     }
-    global_scope->add_function(function->name, function_type);
+    global_scope->add_function(function.name, function_type);
 }
 
-void AstResolver::resolve_types_function(unique_ptr<Function> &function, GlobalScope* global_scope)
+void AstResolver::resolve_types_function(Function& function, GlobalScope* global_scope)
 {
     FunctionType function_type;
 
-    function->return_type = this->resolve_type(function->return_type);
-    function_type.return_type = function->return_type;
+    function.return_type = this->resolve_type(function.return_type);
+    function_type.return_type = function.return_type;
 
-    for(size_t i = 0; i < function->parameters.size(); i++)
+    for(FunctionParameter& parameter: this->module->get_list(function.parameters))
     {
-        function->parameters[i].type = this->resolve_type(function->parameters[i].type);
-        function_type.arguments.push_back(function->parameters[i].type);
+        parameter.type = this->resolve_type(parameter.type);
+        function_type.arguments.push_back(parameter.type);
     }
-    global_scope->add_function(function->name, function_type);
+    global_scope->add_function(function.name, function_type);
 }
 
 
-void AstResolver::resolve_types_function_block(unique_ptr<Function> &function, GlobalScope *global_scope)
+void AstResolver::resolve_types_function_block(Function& function, const GlobalScope* global_scope)
 {
     //TODO add global variables
-    LocalScope function_scope(nullptr, global_scope);
-    for(FunctionParameter& parameter: function->parameters)
+    LocalScope function_scope(global_scope);
+    ScopedSymbolTable<TypeId>::Scope parameter_scope(&function_scope.variables);
+    for(FunctionParameter& parameter: this->module->get_list(function.parameters))
     {
         function_scope.add_variable(parameter.name, parameter.type);
     }
-    this->resolve_types_block(function, function->block, &function_scope);
+    this->resolve_types_block(function, function.block, &function_scope);
+
+    if(this->stats != nullptr)
+    {
+        this->stats->resolver_scope_lookups += function_scope.variables.get_lookup_count();
+        this->stats->resolver_scope_probes += function_scope.variables.get_probe_count();
+    }
 }
 
-void AstResolver::resolve_types_block(unique_ptr<Function>& function, unique_ptr<Block>& block, LocalScope* parent_scope)
+void AstResolver::resolve_types_block(Function& function, BlockId block, LocalScope* local_scope)
 {
-    LocalScope block_scope(parent_scope);
+    ScopedSymbolTable<TypeId>::Scope block_scope(&local_scope->variables);
+
+    for(StatementRef statement: this->module->get_block(block))
+    {
+        this->resolve_types_statement(function, statement, local_scope);
+    }
+}
 
-    for(unique_ptr<Statement>& statement: block->statements)
+void AstResolver::resolve_types_statement(Function& function, StatementRef statement, LocalScope* local_scope)
+{
+    switch (statement.get_type())
     {
-        switch (statement->statement_type)
+        case StatementType::Declaration:
+        {
+            DeclarationStatement& declaration_node = this->module->get<DeclarationStatement>(statement);
+            declaration_node.variable_type = this->resolve_type(declaration_node.variable_type);
+            this->require_type(declaration_node.expression, declaration_node.variable_type, local_scope);
+            local_scope->add_variable(declaration_node.name, declaration_node.variable_type);
+        }
+            break;
+        case StatementType::Assignment:
+        {
+            AssignmentStatement& assignment_node = this->module->get<AssignmentStatement>(statement);
+            TypeId type = local_scope->get_variable_type(assignment_node.name);
+            this->require_type(assignment_node.expression, type, local_scope);
+        }
+            break;
+        case StatementType::Block:
+            this->resolve_types_block(function, this->module->get<BlockStatement>(statement).block, local_scope);
+            break;
+        case StatementType::FunctionCall:
+        {
+            //Function Call statement doesn't care about return type
+            FunctionCallStatement& function_call = this->module->get<FunctionCallStatement>(statement);
+            this->resolve_call(function_call.function_name, function_call.arguments, local_scope);
+        }
+            break;
+        case StatementType::If:
+        {
+            //The condition can be any int or float, codegen compares it against zero of its own type
+            IfStatement& if_node = this->module->get<IfStatement>(statement);
+            this->resolve_condition(if_node.condition, local_scope);
+            this->resolve_types_block(function, if_node.if_block, local_scope);
+            if(if_node.else_block != InvalidBlock)
+            {
+                this->resolve_types_block(function, if_node.else_block, local_scope);
+            }
+        }
+            break;
+        case StatementType::While:
         {
-            case StatementType::Declaration:
+            //A for loop's init is declared in a scope of its own around the loop, conditions work like an if's
+            WhileLoopStatement& loop_node = this->module->get<WhileLoopStatement>(statement);
+            ScopedSymbolTable<TypeId>::Scope loop_scope(&local_scope->variables);
+            if(loop_node.init.is_valid())
             {
-                DeclarationStatement *declaration_node = (DeclarationStatement *)statement.get();
-                declaration_node->type = this->resolve_type(declaration_node->type);
-                this->resolve_types_expression(declaration_node->expression, declaration_node->type, &block_scope);
-                block_scope.add_variable(declaration_node->name, declaration_node->type);
+                this->resolve_types_statement(function, loop_node.init, local_scope);
             }
-                break;
-            case StatementType::Assignment:
+            if(loop_node.condition.is_valid())
             {
-                AssignmentStatement* assignment_node = (AssignmentStatement*)statement.get();
-                shared_ptr<Type> type = block_scope.get_variable_type(assignment_node->name);
-                this->resolve_types_expression(assignment_node->expression, type, &block_scope);
+                this->resolve_condition(loop_node.condition, local_scope);
             }
-                break;
-            case StatementType::Block:
-                this->resolve_types_block(function, ((BlockStatement*)statement.get())->block, &block_scope);
-                break;
-            case StatementType::FunctionCall:
+            if(loop_node.step.is_valid())
             {
-                //Function Call statement doesn't care about return type
-                FunctionCallStatement* function_call = (FunctionCallStatement*)statement.get();
-                FunctionType function_type = block_scope.get_function_type(function_call->function_name);
-                for(size_t i = 0; i < function_call->arguments.size(); i++)
-                {
-                    this->resolve_types_expression(function_call->arguments[i], function_type.arguments[i], &block_scope);
-                }
+                this->resolve_types_statement(function, loop_node.step, local_scope);
             }
-                break;
-            case StatementType::If:
-                break;
-            case StatementType::While:
-                break;
-            case StatementType::Return:
-                this->resolve_types_expression(((ReturnStatement*)statement.get())->return_expression, function->return_type, &block_scope);
-                break;
+
+            local_scope->loop_depth++;
+            this->resolve_types_block(function, loop_node.loop_block, local_scope);
+            local_scope->loop_depth--;
         }
+            break;
+        case StatementType::Jump:
+            if(local_scope->loop_depth == 0)
+            {
+                fail("Error: %s outside of a loop in %s\n", this->module->get<JumpStatement>(statement).jump == JumpType::Break ? "break" : "continue", StringCache::c_str(function.name));
+            }
+            break;
+        case StatementType::Return:
+            this->require_type(this->module->get<ReturnStatement>(statement).return_expression, function.return_type, local_scope);
+            break;
     }
 }
 
-shared_ptr<Type> AstResolver::resolve_type(shared_ptr<Type> unresolved_type)
+TypeId AstResolver::resolve_type(TypeId unresolved_type)
 {
-    string name = ((UnresolvedType*)unresolved_type.get())->get_name();
+    //A deferred body is resolved a second time, its declarations already hold canonical ids
+    if(TypeTable::is_resolved(unresolved_type))
+    {
+        return unresolved_type;
+    }
+
+    StringId name = TypeTable::get_unresolved_name(unresolved_type);
     auto iterator = this->type_map.find(name);
     if(iterator == this->type_map.end())
     {
-        printf("Error: cannot resolve type: %s\n", name.c_str());
-        exit(-1);
+        fail("Error: cannot resolve type: %s\n", StringCache::c_str(name));
     }
     return iterator->second;
 }
 
-TypeClass get_type_class(unique_ptr<Expression>& expression, LocalScope* local_scope)
+TypeId AstResolver::get_literal_type(TypeId expected_type, TypeClass literal_class)
 {
-    switch (expression->expression_type)
+    //Literals take the type the surrounding expression expects, or a default one if nothing is expected
+    if(expected_type != TypeTable::Invalid)
     {
-        case ExpressionType::ConstInt:
-            return TypeClass::Int;
-        case ExpressionType::ConstFloat:
-            return TypeClass::Float;
-        case ExpressionType::Identifier:
-            return local_scope->get_variable_type(((IdentifierExpression*) expression.get())->identifier_name)->get_class();
-        case ExpressionType::BinaryOperator:
-        {
-            BinaryOperatorExpression* bin_op = (BinaryOperatorExpression*)expression.get();
-            return get_type_class(bin_op->lhs, local_scope);
-        }
-        case ExpressionType::Function:
-            return local_scope->get_function_type(((FunctionCallExpression*)expression.get())->function_name).return_type->get_class();
+        return expected_type;
+    }
+    return literal_class == TypeClass::Int ? TypeTable::get_id(TypeEnum::Int32) : TypeTable::get_id(TypeEnum::Float64);
+}
+
+void AstResolver::require_type(ExpressionRef expression, TypeId required_type, LocalScope* local_scope)
+{
+    if(this->resolve_types_expression(expression, required_type, local_scope) != required_type)
+    {
+        fail("Error: type mismatch\n");
     }
+}
 
-    return TypeClass::Invalid;
+//Checks the call's arguments against the callee's parameters, the count first so neither list is read past its end
+const FunctionType& AstResolver::resolve_call(StringId function_name, FunctionArguments arguments, LocalScope* local_scope)
+{
+    const FunctionType& function_type = local_scope->get_function_type(function_name);
+    NodeSpan<ExpressionRef> argument_nodes = this->module->get_list(arguments);
+    if(argument_nodes.size() != function_type.arguments.size())
+    {
+        fail("Error: %s expected %zu arguments, got %zu\n", StringCache::c_str(function_name), function_type.arguments.size(), argument_nodes.size());
+    }
+
+    for(size_t i = 0; i < argument_nodes.size(); i++)
+    {
+        this->require_type(argument_nodes[i], function_type.arguments[i], local_scope);
+    }
+    return function_type;
+}
+
+void AstResolver::resolve_condition(ExpressionRef condition, LocalScope* local_scope)
+{
+    TypeId condition_type = this->resolve_types_expression(condition, TypeTable::Invalid, local_scope);
+    TypeClass condition_class = TypeTable::get_class(condition_type);
+    if(condition_class != TypeClass::Int && condition_class != TypeClass::Float)
+    {
+        fail("Error: a value of type %s cannot be a condition\n", TypeTable::get(condition_type).name);
+    }
 }
 
-void AstResolver::resolve_types_expression(unique_ptr<Expression>& expression, shared_ptr<Type> required_type, LocalScope* local_scope)
+//Single bottom up pass, every node is visited once and its resolved type is stored on it for codegen
+//expected_type is only used to type literals, callers check the returned type against what they need
+TypeId AstResolver::resolve_types_expression(ExpressionRef expression, TypeId expected_type, LocalScope* local_scope)
 {
-    switch (expression->expression_type)
+    switch (expression.get_type())
     {
         case ExpressionType::ConstInt:
         {
-            ConstantIntegerExpression* const_int = (ConstantIntegerExpression*)expression.get();
-            const_int->resolve_value(required_type);
+            ConstantIntegerExpression& const_int = this->module->get<ConstantIntegerExpression>(expression);
+            if(!const_int.resolve_value(this->get_literal_type(expected_type, TypeClass::Int)))
+            {
+                fail("Error: cannot cast int to type\n");
+            }
+            return const_int.resolved_type;
         }
-            break;
         case ExpressionType::ConstFloat:
         {
-            ConstantDoubleExpression* const_float = (ConstantDoubleExpression*)expression.get();
-            const_float->resolve_value(required_type);
+            ConstantDoubleExpression& const_float = this->module->get<ConstantDoubleExpression>(expression);
+            if(!const_float.resolve_value(this->get_literal_type(expected_type, TypeClass::Float)))
+            {
+                fail("Error: cannot cast float to type\n");
+            }
+            return const_float.resolved_type;
         }
-            break;
         case ExpressionType::Identifier:
         {
-            shared_ptr<Type> variable_type = local_scope->get_variable_type(((IdentifierExpression*) expression.get())->identifier_name);
-            if(variable_type != required_type)
-            {
-                printf("Error: type mismatch");
-                exit(-1);
-            }
+            IdentifierExpression& identifier = this->module->get<IdentifierExpression>(expression);
+            identifier.resolved_type = local_scope->get_variable_type(identifier.identifier_name);
+            return identifier.resolved_type;
         }
-            break;
         case ExpressionType::Function:
         {
-            FunctionCallExpression* function_call = (FunctionCallExpression*)expression.get();
-            FunctionType function_type = local_scope->get_function_type(function_call->function_name);
-
-            if(required_type != function_type.return_type)
-            {
-                printf("Error: type mismatch!!!\n");
-                exit(-1);
-            }
-
-            for(size_t i = 0; i < function_type.arguments.size(); i++)
-            {
-                this->resolve_types_expression(function_call->arguments[i], function_type.arguments[i], local_scope);
-            }
+            FunctionCallExpression& function_call = this->module->get<FunctionCallExpression>(expression);
+            function_call.resolved_type = this->resolve_call(function_call.function_name, function_call.arguments, local_scope).return_type;
+            return function_call.resolved_type;
         }
-            break;
         case ExpressionType::BinaryOperator:
         {
-            BinaryOperatorExpression* bin_op_node = (BinaryOperatorExpression*) expression.get();
-            TypeClass lhs_type = get_type_class(bin_op_node->lhs, local_scope);
+            BinaryOperatorExpression& bin_op_node = this->module->get<BinaryOperatorExpression>(expression);
+            if(bin_op_node.op >= MathOperator::EQUAL)
+            {
+                return this->resolve_types_comparison(bin_op_node, local_scope);
+            }
 
-            //In the case of int or float, both lhs and rhs are assumed to be the same type and that type should match the required type
-            if(lhs_type == TypeClass::Int)
+            //Both sides must be the same type, the lhs decides it and the rhs is checked against it
+            TypeId lhs_type = this->resolve_types_expression(bin_op_node.lhs, expected_type, local_scope);
+            this->require_type(bin_op_node.rhs, lhs_type, local_scope);
+            bin_op_node.resolved_type = lhs_type;
+
+            if(TypeTable::get_class(lhs_type) == TypeClass::Int)
             {
-                IntType* int_type = (IntType*) required_type.get();
-                this->resolve_types_expression(bin_op_node->lhs, required_type, local_scope);
-                this->resolve_types_expression(bin_op_node->rhs, required_type, local_scope);
+                bool is_signed = TypeTable::get(lhs_type).is_signed;
 
-                switch (bin_op_node->op)
+                switch (bin_op_node.op)
                 {
                     case MathOperator::ADD:
-                        bin_op_node->binary_op = BinaryOperator::Iadd;
+                        bin_op_node.binary_op = BinaryOperator::Iadd;
                         break;
                     case MathOperator::SUB:
-                        bin_op_node->binary_op = BinaryOperator::Isub;
+                        bin_op_node.binary_op = BinaryOperator::Isub;
                         break;
                     case MathOperator::MUL:
-                        bin_op_node->binary_op = BinaryOperator::Imul;
+                        bin_op_node.binary_op = BinaryOperator::Imul;
                         break;
                     case MathOperator::DIV:
                     {
-                        if (int_type->is_signed())
+                        if (is_signed)
                         {
-                            bin_op_node->binary_op = BinaryOperator::Idiv;
+                            bin_op_node.binary_op = BinaryOperator::Idiv;
                         }
                         else
                         {
-                            bin_op_node->binary_op = BinaryOperator::Udiv;
+                            bin_op_node.binary_op = BinaryOperator::Udiv;
                         }
                     }
                         break;
                     case MathOperator::MOD:
                     {
-                        if (int_type->is_signed())
+                        if (is_signed)
                         {
-                            bin_op_node->binary_op = BinaryOperator::Imod;
+                            bin_op_node.binary_op = BinaryOperator::Imod;
                         }
                         else
                         {
-                            bin_op_node->binary_op = BinaryOperator::Umod;
+                            bin_op_node.binary_op = BinaryOperator::Umod;
                         }
                     }
                         break;
+                    default:
+                        break;
                 }
             }
-            else if(lhs_type == TypeClass::Float)
+            else if(TypeTable::get_class(lhs_type) == TypeClass::Float)
             {
-                this->resolve_types_expression(bin_op_node->lhs, required_type, local_scope);
-                this->resolve_types_expression(bin_op_node->rhs, required_type, local_scope);
-
-                switch (bin_op_node->op)
+                switch (bin_op_node.op)
                 {
                     case MathOperator::ADD:
-                        bin_op_node->binary_op = BinaryOperator::Fadd;
+                        bin_op_node.binary_op = BinaryOperator::Fadd;
                         break;
                     case MathOperator::SUB:
-                        bin_op_node->binary_op = BinaryOperator::Fsub;
+                        bin_op_node.binary_op = BinaryOperator::Fsub;
                         break;
                     case MathOperator::MUL:
-                        bin_op_node->binary_op = BinaryOperator::Fmul;
+                        bin_op_node.binary_op = BinaryOperator::Fmul;
                         break;
                     case MathOperator::DIV:
-                        bin_op_node->binary_op = BinaryOperator::Fdiv;
+                        bin_op_node.binary_op = BinaryOperator::Fdiv;
                         break;
                     case MathOperator::MOD:
-                        bin_op_node->binary_op = BinaryOperator::Fmod;
+                        bin_op_node.binary_op = BinaryOperator::Fmod;
+                        break;
+                    default:
                         break;
                 }
             }
-            else if(lhs_type == TypeClass::Struct)
+            else
             {
-                //TODO
+                //TODO structs will have to determine the correct operator overload function based on type of LHS and return_type/required_type
+                fail("Error: no arithmetic for values of type %s\n", TypeTable::get(lhs_type).name);
             }
 
-            /* If lhs type class is int:
-             * - resolve lhs for required_type, error if not a type_match
-             * - resolve rhs for required_type, error if not a type_match
-             * - determine correct int op (signed or unsigned)
-             *
-             * If lhs type class is float:
-             * - resolve lhs for required_type, error if not a type_match
-             * - resolve rhs for required_type, error if not a type_match
-             * - determine correct float op
-             *
-             * TODO If lhs type class is struct
-             * - Will have to determine correct operator overload function based on type of LHS and return_type/required_type
-             * */
+            return bin_op_node.resolved_type;
         }
+    }
+
+    return TypeTable::Invalid;
+}
+
+//Operands follow the same rules as arithmetic, the result is always a bool
+TypeId AstResolver::resolve_types_comparison(BinaryOperatorExpression& bin_op_node, LocalScope* local_scope)
+{
+    //Nothing is expected of the operands, so the side that is not a literal decides the type and 10 > value types like value > 10
+    ExpressionType lhs_kind = bin_op_node.lhs.get_type();
+    TypeId operand_type;
+    if(lhs_kind == ExpressionType::ConstInt || lhs_kind == ExpressionType::ConstFloat)
+    {
+        operand_type = this->resolve_types_expression(bin_op_node.rhs, TypeTable::Invalid, local_scope);
+        this->require_type(bin_op_node.lhs, operand_type, local_scope);
+    }
+    else
+    {
+        operand_type = this->resolve_types_expression(bin_op_node.lhs, TypeTable::Invalid, local_scope);
+        this->require_type(bin_op_node.rhs, operand_type, local_scope);
+    }
+    bin_op_node.resolved_type = TypeTable::get_id(TypeEnum::Bool);
+
+    //Ordered in MathOperator order, EQUAL first
+    static const BinaryOperator signed_operators[] = {BinaryOperator::Ieq, BinaryOperator::Ine, BinaryOperator::Ilt, BinaryOperator::Ile, BinaryOperator::Igt, BinaryOperator::Ige};
+    static const BinaryOperator unsigned_operators[] = {BinaryOperator::Ieq, BinaryOperator::Ine, BinaryOperator::Ult, BinaryOperator::Ule, BinaryOperator::Ugt, BinaryOperator::Uge};
+    static const BinaryOperator float_operators[] = {BinaryOperator::Feq, BinaryOperator::Fne, BinaryOperator::Flt, BinaryOperator::Fle, BinaryOperator::Fgt, BinaryOperator::Fge};
+    size_t index = (size_t)bin_op_node.op - (size_t)MathOperator::EQUAL;
+
+    switch (TypeTable::get_class(operand_type))
+    {
+        case TypeClass::Int:
+            bin_op_node.binary_op = TypeTable::get(operand_type).is_signed ? signed_operators[index] : unsigned_operators[index];
             break;
+        case TypeClass::Float:
+            bin_op_node.binary_op = float_operators[index];
+            break;
+        default:
+            fail("Error: cannot compare values of type %s\n", TypeTable::get(operand_type).name);
     }
-}
\ No newline at end of file
+    return bin_op_node.resolved_type;
+}
@@ -3,53 +3,91 @@
 #include "types.hpp"
 #include "ast/module.hpp"
 #include "ast/expression.hpp"
+#include "scoped_symbol_table.hpp"
+#include "thread_pool.hpp"
+#include "time_report.hpp"
+#include "compile_stats.hpp"
 
 struct FunctionType
 {
-    shared_ptr<Type> return_type;
-    vector<shared_ptr<Type>> arguments;
+    TypeId return_type;
+    vector<TypeId> arguments;
 };
 
+//Thrown by a failed check, bodies are resolved in parallel so each function catches its own first error
+struct ResolveError
+{
+    string message;
+
+    //Set when a called function is not declared, streaming retries the body once the whole file is parsed
+    bool missing_function = false;
+};
+
+//Filled in before any function body is resolved and only read after that, so bodies can share it across threads
 class GlobalScope
 {
 protected:
-    unordered_map<string, FunctionType> functions_types;
+    unordered_map<StringId, FunctionType> functions_types;
 
 public:
-    void add_function(const string& name, const FunctionType& variable_type);
-    FunctionType get_function_type(const string& name);
+    void add_function(StringId name, const FunctionType& variable_type);
+    const FunctionType& get_function_type(StringId name) const;
 };
 
+//Variables visible while resolving one function body, each block opens a scope on the shared table
 class LocalScope
 {
 protected:
-    GlobalScope* global_scope;
-    LocalScope* parent_scope;
-    unordered_map<string, shared_ptr<Type>> variable_types;
+    const GlobalScope* global_scope;
 
 public:
-    LocalScope(LocalScope* parent_scope, GlobalScope* global_scope = nullptr);
-    void add_variable(const string& name, shared_ptr<Type> variable_type);
-    shared_ptr<Type> get_variable_type(const string& name);
-    FunctionType get_function_type(const string& name);
+    ScopedSymbolTable<TypeId> variables;
+
+    //Loops around the statement being resolved, break and continue need at least one
+    uint32_t loop_depth = 0;
+
+    LocalScope(const GlobalScope* global_scope);
+    void add_variable(StringId name, TypeId variable_type);
+    TypeId get_variable_type(StringId name);
+    const FunctionType& get_function_type(StringId name);
 };
 
 class AstResolver
 {
 public:
-    AstResolver();
+    AstResolver(TimeReport* time_report = nullptr, CompileStats* stats = nullptr);
+
+    //Function bodies are spread over thread_pool when one is given, errors are printed in source order
+    //Returns false if the module has any errors
+    bool resolve(Module* module, ThreadPool* thread_pool = nullptr);
 
-    void resolve(Module* module);
+    //Streaming, each item is resolved as soon as it is parsed, these throw ResolveError
+    void begin(Module* module) { this->module = module; };
+    void resolve_struct(Struct& struct_object) { this->resolve_types_struct(struct_object); };
+    void resolve_extern(ExternFunction& function) { this->resolve_types_extern(function, &this->global_scope); };
+    void resolve_function(Function& function) { this->resolve_types_function(function, &this->global_scope); };
+    void resolve_function_body(Function& function) { this->resolve_types_function_block(function, &this->global_scope); };
 
 protected:
-    unordered_map<string, shared_ptr<Type>> type_map;
+    Module* module = nullptr;
+    TimeReport* time_report = nullptr;
+    CompileStats* stats = nullptr;
+    GlobalScope global_scope;
+    unordered_map<StringId, TypeId> type_map;
 
-    void resolve_types_struct(unique_ptr<Struct> &struct_object);
-    void resolve_types_extern(unique_ptr<ExternFunction> &function, GlobalScope* global_scope);
-    void resolve_types_function(unique_ptr<Function>& function, GlobalScope* global_scope);
-    void resolve_types_function_block(unique_ptr<Function>& function, GlobalScope* global_scope);
-    void resolve_types_block(unique_ptr<Function> &function, unique_ptr<Block>& block, LocalScope* parent_scope);
-    shared_ptr<Type> resolve_type(shared_ptr<Type> unresolved_type);
+    void resolve_types_struct(Struct& struct_object);
+    void resolve_types_extern(ExternFunction& function, GlobalScope* global_scope);
+    void resolve_types_function(Function& function, GlobalScope* global_scope);
+    void resolve_types_function_blocks(size_t first, size_t last, const GlobalScope* global_scope, vector<string>& errors);
+    void resolve_types_function_block(Function& function, const GlobalScope* global_scope);
+    void resolve_types_block(Function& function, BlockId block, LocalScope* local_scope);
+    void resolve_types_statement(Function& function, StatementRef statement, LocalScope* local_scope);
+    TypeId resolve_type(TypeId unresolved_type);
 
-    void resolve_types_expression(unique_ptr<Expression>& expression, shared_ptr<Type> required_type, LocalScope* local_scope);
+    TypeId get_literal_type(TypeId expected_type, TypeClass literal_class);
+    void require_type(ExpressionRef expression, TypeId required_type, LocalScope* local_scope);
+    void resolve_condition(ExpressionRef condition, LocalScope* local_scope);
+    const FunctionType& resolve_call(StringId function_name, FunctionArguments arguments, LocalScope* local_scope);
+    TypeId resolve_types_expression(ExpressionRef expression, TypeId expected_type, LocalScope* local_scope);
+    TypeId resolve_types_comparison(BinaryOperatorExpression& bin_op_node, LocalScope* local_scope);
 };
\ No newline at end of file
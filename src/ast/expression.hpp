@@ -2,17 +2,25 @@
 
 #include "containers.hpp"
 #include "ast/types.hpp"
+#include "ast/node_list.hpp"
 
-enum class MathOperator
+enum class MathOperator : uint8_t
 {
     ADD,
     SUB,
     MUL,
     DIV,
-    MOD
+    MOD,
+
+    EQUAL,
+    NOT_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
 };
 
-enum class BinaryOperator
+enum class BinaryOperator : uint8_t
 {
     Iadd,
     Isub,
@@ -28,6 +36,25 @@ enum class BinaryOperator
     Fdiv,
     Fmod,
 
+    //Comparisons give a bool, integers compare signed or unsigned by their type, floats are ordered except !=
+    Ieq,
+    Ine,
+    Ilt,
+    Ile,
+    Igt,
+    Ige,
+    Ult,
+    Ule,
+    Ugt,
+    Uge,
+
+    Feq,
+    Fne,
+    Flt,
+    Fle,
+    Fgt,
+    Fge,
+
     Function,
     Invalid,
 };
@@ -41,104 +68,121 @@ enum class ExpressionType
     BinaryOperator,
 };
 
-struct Expression
+//32 bit handle to an expression, the top bits hold the kind and the rest index into the module array for that kind
+struct ExpressionRef
 {
-    Expression(ExpressionType type) : expression_type(type){};
-    const ExpressionType expression_type;
+    static const uint32_t kind_shift = 29;
+    static const uint32_t index_mask = (1u << kind_shift) - 1;
+    static const uint32_t invalid_value = 0xFFFFFFFF;
+
+    //Left trivial so it can live in the parser's value union
+    uint32_t value;
+
+    ExpressionRef() = default;
+    ExpressionRef(ExpressionType type, uint32_t index) : value(((uint32_t)type << kind_shift) | index){};
+    static ExpressionRef invalid() { ExpressionRef ref; ref.value = invalid_value; return ref; };
+
+    ExpressionType get_type() const { return (ExpressionType)(this->value >> kind_shift); };
+    uint32_t get_index() const { return this->value & index_mask; };
+    bool is_valid() const { return this->value != invalid_value; };
 };
 
-struct ConstantIntegerExpression : Expression
+typedef NodeList<ExpressionRef> FunctionArguments;
+
+//Expression nodes are plain structs stored by kind in Module, children are ExpressionRefs
+//resolved_type is filled in by AstResolver so codegen never has to work a type out again
+struct ConstantIntegerExpression
 {
-    shared_ptr<Type> int_type;
+    static const ExpressionType type = ExpressionType::ConstInt;
+
+    TypeId resolved_type = TypeTable::Invalid;
     uint64_t value;
 
     ConstantIntegerExpression(long value)
-    :Expression(ExpressionType::ConstInt)
     {
         this->value = value;
     };
 
-    void resolve_value(shared_ptr<Type> type)
+    //Returns false if the literal cannot take this type
+    bool resolve_value(TypeId type)
     {
-        if(type->get_class() != TypeClass::Int)
+        if(TypeTable::get_class(type) != TypeClass::Int)
         {
-            printf("Error: cannot cast int to type\n");
-            exit(-1);
+            return false;
         }
 
-        this->int_type = type;
+        this->resolved_type = type;
+        return true;
     }
 };
 
-struct ConstantDoubleExpression : Expression
+struct ConstantDoubleExpression
 {
-    shared_ptr<Type> float_type;
+    static const ExpressionType type = ExpressionType::ConstFloat;
+
+    TypeId resolved_type = TypeTable::Invalid;
     double value;
 
     ConstantDoubleExpression(double value)
-    :Expression(ExpressionType::ConstFloat)
     {
         this->value = value;
     };
 
-    void resolve_value(shared_ptr<Type> type)
+    //Returns false if the literal cannot take this type
+    bool resolve_value(TypeId type)
     {
-        if(type->get_class() != TypeClass::Float)
+        if(TypeTable::get_class(type) != TypeClass::Float)
         {
-            printf("Error: cannot cast float to type\n");
-            exit(-1);
+            return false;
         }
 
-        this->float_type = type;
+        this->resolved_type = type;
+        return true;
     }
 };
 
-struct IdentifierExpression : Expression
+struct IdentifierExpression
 {
-    std::string identifier_name;
+    static const ExpressionType type = ExpressionType::Identifier;
 
-    IdentifierExpression(const string& name)
-    :Expression(ExpressionType::Identifier)
+    TypeId resolved_type = TypeTable::Invalid;
+    StringId identifier_name;
+
+    IdentifierExpression(StringId name)
     {
         this->identifier_name = name;
     }
 };
 
-typedef vector<Expression*> FunctionArguments;
-struct FunctionCallExpression : Expression
+struct FunctionCallExpression
 {
-    std::string function_name;
-    vector<unique_ptr<Expression>> arguments;
+    static const ExpressionType type = ExpressionType::Function;
+
+    TypeId resolved_type = TypeTable::Invalid;
+    StringId function_name;
+    FunctionArguments arguments;
 
-    FunctionCallExpression(const string& name, FunctionArguments* argument_list = nullptr)
-    :Expression(ExpressionType::Function)
+    FunctionCallExpression(StringId name, FunctionArguments arguments = FunctionArguments())
     {
         this->function_name = name;
-
-        if(argument_list)
-        {
-            arguments.resize(argument_list->size());
-            for(size_t i = 0; i < arguments.size(); i++)
-            {
-                arguments[i] = unique_ptr<Expression>(argument_list->at(i));
-            }
-            delete argument_list;
-        }
+        this->arguments = arguments;
     }
 };
 
-struct BinaryOperatorExpression : Expression
+struct BinaryOperatorExpression
 {
+    static const ExpressionType type = ExpressionType::BinaryOperator;
+
+    TypeId resolved_type = TypeTable::Invalid;
     MathOperator op;
     BinaryOperator binary_op = BinaryOperator::Invalid;
-    unique_ptr<Expression> lhs;
-    unique_ptr<Expression> rhs;
+    ExpressionRef lhs;
+    ExpressionRef rhs;
 
-    BinaryOperatorExpression(MathOperator op, Expression* l, Expression* r)
-    :Expression(ExpressionType::BinaryOperator)
+    BinaryOperatorExpression(MathOperator op, ExpressionRef l, ExpressionRef r)
     {
         this->op = op;
-        this->lhs = unique_ptr<Expression>(l);
-        this->rhs = unique_ptr<Expression>(r);
+        this->lhs = l;
+        this->rhs = r;
     };
-};
\ No newline at end of file
+};
@@ -6,53 +6,46 @@
 
 struct FunctionParameter
 {
-    shared_ptr<Type> type;
-    string name;
+    TypeId type;
+    StringId name;
 };
-typedef vector<FunctionParameter> FunctionParameters;
+typedef NodeList<FunctionParameter> FunctionParameters;
 
 struct Function
 {
-    string name;
-    shared_ptr<Type> return_type;
-    vector<FunctionParameter> parameters;
-    unique_ptr<Block> block;
+    StringId name;
+    TypeId return_type;
+    FunctionParameters parameters;
+    BlockId block;
 
-    Function(const string& return_type, const string& name, FunctionParameters* parameters = nullptr, Block* block = nullptr)
+    //Byte offset of the function's first token in its file, only turned into a line for debug info
+    uint32_t offset;
+
+    //Targets from @target_clones(avx2, default), the function gets a body for each and picks one for the CPU it runs on
+    NodeList<StringId> target_clones;
+
+    Function(StringId return_type, StringId name, FunctionParameters parameters = FunctionParameters(), BlockId block = InvalidBlock, uint32_t offset = 0,
+             NodeList<StringId> target_clones = NodeList<StringId>())
     {
         this->name = name;
-        this->return_type = std::make_shared<UnresolvedType>(return_type);
-        this->block = unique_ptr<Block>(block);
-        if(parameters)
-        {
-            this->parameters.resize(parameters->size());
-            for(size_t i = 0; i < this->parameters.size(); i++)
-            {
-                this->parameters[i] = parameters->at(i);
-            }
-            delete parameters;
-        }
+        this->return_type = TypeTable::unresolved(return_type);
+        this->parameters = parameters;
+        this->block = block;
+        this->offset = offset;
+        this->target_clones = target_clones;
     };
 };
 
 struct ExternFunction
 {
-    string name;
-    shared_ptr<Type> return_type;
-    vector<FunctionParameter> parameters;
+    StringId name;
+    TypeId return_type;
+    FunctionParameters parameters;
 
-    ExternFunction(const string& return_type, const string& name, FunctionParameters* parameters = nullptr)
+    ExternFunction(StringId return_type, StringId name, FunctionParameters parameters = FunctionParameters())
     {
         this->name = name;
-        this->return_type = std::make_shared<UnresolvedType>(return_type);
-        if(parameters)
-        {
-            this->parameters.resize(parameters->size());
-            for(size_t i = 0; i < this->parameters.size(); i++)
-            {
-                this->parameters[i] = parameters->at(i);
-            }
-            delete parameters;
-        }
+        this->return_type = TypeTable::unresolved(return_type);
+        this->parameters = parameters;
     };
-};
\ No newline at end of file
+};
@@ -1,14 +1,192 @@
 #pragma once
 
 #include "containers.hpp"
+#include "arena.hpp"
 #include "struct.hpp"
 #include "function.hpp"
 
+//Sizes of every node array at one point of the parse
+struct NodeMark
+{
+    static const size_t array_count = 19;
+    size_t sizes[array_count];
+};
+
+//The AST is stored flat, every kind of node lives in its own contiguous array and nodes refer to each other with 32 bit handles
+//Lists of nodes (arguments, block statements, parameters, members, attribute names) are runs in shared list arrays
 struct Module
 {
+    //Holds the parser's temporary lists, declared first so it is destroyed last
+    Arena arena;
+
     string name;
-    //TODO remove unique_ptr from these???
-    vector<unique_ptr<Struct>> structs;
-    vector<unique_ptr<Function>> functions;
-    vector<unique_ptr<ExternFunction>> extern_functions;
-};
\ No newline at end of file
+
+    //Tokens the parser read for this module, for --stats
+    size_t token_count = 0;
+
+    vector<Struct> structs;
+    vector<Function> functions;
+    vector<ExternFunction> extern_functions;
+
+    vector<ConstantIntegerExpression> const_int_expressions;
+    vector<ConstantDoubleExpression> const_float_expressions;
+    vector<IdentifierExpression> identifier_expressions;
+    vector<FunctionCallExpression> function_call_expressions;
+    vector<BinaryOperatorExpression> binary_operator_expressions;
+
+    vector<DeclarationStatement> declaration_statements;
+    vector<AssignmentStatement> assignment_statements;
+    vector<BlockStatement> block_statements;
+    vector<FunctionCallStatement> function_call_statements;
+    vector<IfStatement> if_statements;
+    vector<WhileLoopStatement> while_statements;
+    vector<ReturnStatement> return_statements;
+    vector<JumpStatement> jump_statements;
+
+    vector<Block> blocks;
+    vector<ExpressionRef> expression_lists;
+    vector<StatementRef> statement_lists;
+    vector<FunctionParameter> parameter_lists;
+    vector<StructMember> member_lists;
+    vector<StringId> name_lists;
+
+    //Array holding every node of type T, specialised below
+    template<typename T>
+    vector<T>& get_nodes();
+
+    template<typename T>
+    ExpressionRef add_expression(T&& node)
+    {
+        vector<T>& nodes = this->get_nodes<T>();
+        nodes.push_back(std::move(node));
+        return ExpressionRef(T::type, (uint32_t)(nodes.size() - 1));
+    };
+
+    template<typename T>
+    StatementRef add_statement(T&& node)
+    {
+        vector<T>& nodes = this->get_nodes<T>();
+        nodes.push_back(std::move(node));
+        return StatementRef(T::type, (uint32_t)(nodes.size() - 1));
+    };
+
+    //Callers check the handle's kind before asking for a node type
+    template<typename T>
+    T& get(ExpressionRef expression) { return this->get_nodes<T>()[expression.get_index()]; };
+
+    template<typename T>
+    T& get(StatementRef statement) { return this->get_nodes<T>()[statement.get_index()]; };
+
+    template<typename T, typename Allocator>
+    NodeList<T> add_list(const vector<T, Allocator>& items)
+    {
+        vector<T>& nodes = this->get_nodes<T>();
+        NodeList<T> list;
+        list.first = (uint32_t)nodes.size();
+        list.count = (uint32_t)items.size();
+        nodes.insert(nodes.end(), items.begin(), items.end());
+        return list;
+    };
+
+    template<typename T>
+    NodeSpan<T> get_list(NodeList<T> list) { return { this->get_nodes<T>().data() + list.first, list.count }; };
+
+    template<typename Allocator>
+    BlockId add_block(const vector<StatementRef, Allocator>& statements)
+    {
+        this->blocks.push_back(this->add_list(statements));
+        return (BlockId)(this->blocks.size() - 1);
+    };
+
+    NodeSpan<StatementRef> get_block(BlockId block);
+
+    //Type AstResolver recorded on an expression, whatever its kind
+    TypeId get_resolved_type(ExpressionRef expression);
+
+    //Nodes are only ever appended, so everything added after a mark can be dropped by shrinking the arrays back to it
+    NodeMark get_mark();
+    void release_nodes(const NodeMark& mark);
+
+    //Calls function(name, array) for every node array, for marks and --stats
+    template<typename Function>
+    void for_each_node_array(Function function)
+    {
+        function("const_int_expressions", this->const_int_expressions);
+        function("const_float_expressions", this->const_float_expressions);
+        function("identifier_expressions", this->identifier_expressions);
+        function("function_call_expressions", this->function_call_expressions);
+        function("binary_operator_expressions", this->binary_operator_expressions);
+        function("declaration_statements", this->declaration_statements);
+        function("assignment_statements", this->assignment_statements);
+        function("block_statements", this->block_statements);
+        function("function_call_statements", this->function_call_statements);
+        function("if_statements", this->if_statements);
+        function("while_statements", this->while_statements);
+        function("return_statements", this->return_statements);
+        function("jump_statements", this->jump_statements);
+        function("blocks", this->blocks);
+        function("expression_lists", this->expression_lists);
+        function("statement_lists", this->statement_lists);
+        function("parameter_lists", this->parameter_lists);
+        function("member_lists", this->member_lists);
+        function("name_lists", this->name_lists);
+    };
+};
+
+template<> inline vector<ConstantIntegerExpression>& Module::get_nodes() { return this->const_int_expressions; }
+template<> inline vector<ConstantDoubleExpression>& Module::get_nodes() { return this->const_float_expressions; }
+template<> inline vector<IdentifierExpression>& Module::get_nodes() { return this->identifier_expressions; }
+template<> inline vector<FunctionCallExpression>& Module::get_nodes() { return this->function_call_expressions; }
+template<> inline vector<BinaryOperatorExpression>& Module::get_nodes() { return this->binary_operator_expressions; }
+
+template<> inline vector<DeclarationStatement>& Module::get_nodes() { return this->declaration_statements; }
+template<> inline vector<AssignmentStatement>& Module::get_nodes() { return this->assignment_statements; }
+template<> inline vector<BlockStatement>& Module::get_nodes() { return this->block_statements; }
+template<> inline vector<FunctionCallStatement>& Module::get_nodes() { return this->function_call_statements; }
+template<> inline vector<IfStatement>& Module::get_nodes() { return this->if_statements; }
+template<> inline vector<WhileLoopStatement>& Module::get_nodes() { return this->while_statements; }
+template<> inline vector<ReturnStatement>& Module::get_nodes() { return this->return_statements; }
+template<> inline vector<JumpStatement>& Module::get_nodes() { return this->jump_statements; }
+
+template<> inline vector<ExpressionRef>& Module::get_nodes() { return this->expression_lists; }
+template<> inline vector<StatementRef>& Module::get_nodes() { return this->statement_lists; }
+template<> inline vector<FunctionParameter>& Module::get_nodes() { return this->parameter_lists; }
+template<> inline vector<StructMember>& Module::get_nodes() { return this->member_lists; }
+template<> inline vector<StringId>& Module::get_nodes() { return this->name_lists; }
+
+inline NodeSpan<StatementRef> Module::get_block(BlockId block)
+{
+    return this->get_list(this->blocks[block]);
+}
+
+inline NodeMark Module::get_mark()
+{
+    NodeMark mark;
+    size_t i = 0;
+    this->for_each_node_array([&](const char*, auto& nodes) { mark.sizes[i++] = nodes.size(); });
+    return mark;
+}
+
+inline void Module::release_nodes(const NodeMark& mark)
+{
+    size_t i = 0;
+    this->for_each_node_array([&](const char*, auto& nodes) { nodes.erase(nodes.begin() + mark.sizes[i++], nodes.end()); });
+}
+
+inline TypeId Module::get_resolved_type(ExpressionRef expression)
+{
+    switch (expression.get_type())
+    {
+        case ExpressionType::ConstInt:
+            return this->get<ConstantIntegerExpression>(expression).resolved_type;
+        case ExpressionType::ConstFloat:
+            return this->get<ConstantDoubleExpression>(expression).resolved_type;
+        case ExpressionType::Identifier:
+            return this->get<IdentifierExpression>(expression).resolved_type;
+        case ExpressionType::Function:
+            return this->get<FunctionCallExpression>(expression).resolved_type;
+        case ExpressionType::BinaryOperator:
+            return this->get<BinaryOperatorExpression>(expression).resolved_type;
+    }
+    return TypeTable::Invalid;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "containers.hpp"
+
+//Run of consecutive entries in one of the module's list arrays
+//Lists are copied there in one piece once the parser has finished building them, so they never interleave
+template<typename T>
+struct NodeList
+{
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+//View of a NodeList, only valid while the owning array is not growing
+template<typename T>
+struct NodeSpan
+{
+    T* data;
+    uint32_t count;
+
+    T* begin() { return this->data; };
+    T* end() { return this->data + this->count; };
+    uint32_t size() { return this->count; };
+    T& operator[](size_t index) { return this->data[index]; };
+};
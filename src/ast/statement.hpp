@@ -12,121 +12,173 @@ enum class StatementType
     If,
     While,
     Return,
+    Jump,
+    //Kinds live in the top 3 bits of a StatementRef, there is no room for a ninth
 };
 
-struct Statement
+//32 bit handle to a statement, laid out the same way as ExpressionRef
+struct StatementRef
 {
-    Statement(StatementType type) : statement_type(type){};
-    const StatementType statement_type;
+    static const uint32_t kind_shift = 29;
+    static const uint32_t index_mask = (1u << kind_shift) - 1;
+    static const uint32_t invalid_value = 0xFFFFFFFF;
+
+    //Left trivial so it can live in the parser's value union
+    uint32_t value;
+
+    StatementRef() = default;
+    StatementRef(StatementType type, uint32_t index) : value(((uint32_t)type << kind_shift) | index){};
+    static StatementRef invalid() { StatementRef ref; ref.value = invalid_value; return ref; };
+
+    StatementType get_type() const { return (StatementType)(this->value >> kind_shift); };
+    uint32_t get_index() const { return this->value & index_mask; };
+    bool is_valid() const { return this->value != invalid_value; };
 };
 
-struct Block
+//A block is the list of its statements, blocks are stored in Module and referred to by index
+typedef NodeList<StatementRef> Block;
+typedef uint32_t BlockId;
+static const BlockId InvalidBlock = 0xFFFFFFFF;
+
+struct DeclarationStatement
 {
-    vector<unique_ptr<Statement>> statements;
+    static const StatementType type = StatementType::Declaration;
 
-    void push_back(Statement* statement)
+    TypeId variable_type;
+
+    StringId name;
+    ExpressionRef expression;
+
+    DeclarationStatement(StringId type, StringId name, ExpressionRef expression)
     {
-        this->statements.push_back(unique_ptr<Statement>(statement));
+        this->variable_type = TypeTable::unresolved(type);
+        this->name = name;
+        this->expression = expression;
     };
 };
 
-struct DeclarationStatement : Statement
+struct AssignmentStatement
 {
-    shared_ptr<Type> type;
+    static const StatementType type = StatementType::Assignment;
 
-    std::string name;
-    unique_ptr<Expression> expression;
+    StringId name;
+    ExpressionRef expression;
 
-    DeclarationStatement(const string& type, const string& name, Expression* expression)
-    : Statement(StatementType::Declaration)
+    AssignmentStatement(StringId name, ExpressionRef expression)
     {
-        this->type = std::make_shared<UnresolvedType>(type);
         this->name = name;
-        this->expression = unique_ptr<Expression>(expression);
+        this->expression = expression;
     };
 };
 
-struct AssignmentStatement : Statement
+struct BlockStatement
 {
-    std::string name;
-    unique_ptr<Expression> expression;
+    static const StatementType type = StatementType::Block;
+
+    BlockId block;
 
-    AssignmentStatement(const string& name, Expression* expression)
-    : Statement(StatementType::Assignment)
+    BlockStatement(BlockId block)
     {
-        this->name = name;
-        this->expression = unique_ptr<Expression>(expression);
+        this->block = block;
     };
 };
 
-struct BlockStatement : Statement
+struct FunctionCallStatement
 {
-    unique_ptr<Block> block;
+    static const StatementType type = StatementType::FunctionCall;
+
+    StringId function_name;
+    FunctionArguments arguments;
 
-    BlockStatement(Block* block)
-    : Statement(StatementType::Assignment)
+    FunctionCallStatement(StringId name, FunctionArguments arguments = FunctionArguments())
     {
-        this->block = unique_ptr<Block>(block);
-    };
+        this->function_name = name;
+        this->arguments = arguments;
+    }
 };
 
-struct FunctionCallStatement : Statement
+struct IfStatement
 {
-    std::string function_name;
-    vector<unique_ptr<Expression>> arguments;
+    static const StatementType type = StatementType::If;
+
+    ExpressionRef condition;
+    BlockId if_block;
+    BlockId else_block;
 
-    FunctionCallStatement(const string& name, FunctionArguments* argument_list = nullptr)
-            : Statement(StatementType::FunctionCall)
+    IfStatement(ExpressionRef condition, BlockId if_block, BlockId else_block)
     {
-        this->function_name = name;
+        this->condition = condition;
+        this->if_block = if_block;
+        this->else_block = else_block;
+    };
+};
 
-        if(argument_list)
-        {
-            arguments.resize(argument_list->size());
-            for(size_t i = 0; i < arguments.size(); i++)
-            {
-                arguments[i] = unique_ptr<Expression>(argument_list->at(i));
-            }
-            delete argument_list;
-        }
-    }
+//Hints from @unroll(n) and @vectorize(width) in front of a loop, lowered to llvm.loop metadata
+struct LoopHints
+{
+    //No hint, LLVM decides
+    static const uint32_t none = 0;
+
+    //@unroll or @vectorize without a count, unroll fully or vectorize at a width LLVM picks
+    static const uint32_t any = 0xFFFFFFFF;
+
+    uint32_t unroll = none;
+    uint32_t vectorize = none;
 };
 
-struct IfStatement : Statement
+//while, do while and for loops, a for loop is a while loop with an init and a step
+struct WhileLoopStatement
 {
-    unique_ptr<Expression> condition;
-    unique_ptr<Block> if_block;
-    unique_ptr<Block> else_block;
+    static const StatementType type = StatementType::While;
+
+    //Invalid for a for loop without a condition, which runs until a break or return
+    ExpressionRef condition;
+    BlockId loop_block;
+
+    //Declaration or assignment run once before a for loop, its variable is only visible in the loop
+    StatementRef init = StatementRef::invalid();
+
+    //Assignment run after every iteration of a for loop, continue jumps to it
+    StatementRef step = StatementRef::invalid();
 
-    IfStatement(Expression* condition, Block* if_block, Block* else_block)
-    : Statement(StatementType::If)
+    //False for do while, the body runs once before the condition is tested
+    bool test_first = true;
+
+    LoopHints hints;
+
+    WhileLoopStatement(ExpressionRef condition, BlockId block)
     {
-        this->condition = unique_ptr<Expression>(condition);
-        this->if_block = unique_ptr<Block>(if_block);
-        this->else_block = unique_ptr<Block>(else_block);
+        this->condition = condition;
+        this->loop_block = block;
     };
 };
 
-struct WhileLoopStatement : Statement
+enum class JumpType : uint8_t
+{
+    Break,
+    Continue,
+};
+
+struct JumpStatement
 {
-    unique_ptr<Expression> condition;
-    unique_ptr<Block> loop_block;
+    static const StatementType type = StatementType::Jump;
+
+    JumpType jump;
 
-    WhileLoopStatement(Expression* condition, Block* block)
-    : Statement(StatementType::While)
+    JumpStatement(JumpType jump)
     {
-        this->condition = unique_ptr<Expression>(condition);
-        this->loop_block = unique_ptr<Block>(block);
+        this->jump = jump;
     };
 };
 
-struct ReturnStatement : Statement
+struct ReturnStatement
 {
-    unique_ptr<Expression> return_expression;
+    static const StatementType type = StatementType::Return;
 
-    ReturnStatement(Expression* expression)
-    : Statement(StatementType::Return)
+    ExpressionRef return_expression;
+
+    ReturnStatement(ExpressionRef expression)
     {
-        this->return_expression = unique_ptr<Expression>(expression);
+        this->return_expression = expression;
     };
-};
\ No newline at end of file
+};
@@ -2,6 +2,7 @@
 
 #include "containers.hpp"
 #include "ast/types.hpp"
+#include "ast/node_list.hpp"
 
 enum class AccessType
 {
@@ -12,33 +13,31 @@ enum class AccessType
 struct StructMember
 {
     AccessType access;
-    shared_ptr<Type> type;
-    string name;
+    TypeId type;
+    StringId name;
 
-    StructMember(bool is_public, const string& type, const string& name)
+    StructMember(bool is_public, StringId type, StringId name)
     {
         this->access = is_public ? AccessType::Public : AccessType::Private;
-        this->type = std::make_shared<UnresolvedType>(type);
+        this->type = TypeTable::unresolved(type);
         this->name = name;
     }
 };
 
-typedef vector<StructMember> StructMembers;
+typedef NodeList<StructMember> StructMembers;
 
 struct Struct
 {
-    string name;
+    StringId name;
     StructMembers members;
+
+    //Set by AstResolver once the member types are resolved
+    TypeId type = TypeTable::Invalid;
     //TODO add Functions, Operators, Create/Delete Functions
 
-    Struct(const string& name, StructMembers* members)
+    Struct(StringId name, StructMembers members)
     {
         this->name = name;
-
-        if(members)
-        {
-            this->members = *members;
-            delete members;
-        }
+        this->members = members;
     }
 };
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "ast/types.hpp"
+
+#include <algorithm>
+#include <stdio.h>
+
+std::mutex TypeTable::struct_lock;
+unordered_map<string, TypeId> TypeTable::struct_map;
+size_t TypeTable::struct_count = 0;
+unique_ptr<TypeTable::StructInfo[]> TypeTable::struct_chunks[TypeTable::max_struct_chunks];
+
+TypeId TypeTable::add_struct(StringId name, const vector<TypeId>& fields)
+{
+    //Field ids are canonical, so the name and the raw field ids identify the struct
+    string key(reinterpret_cast<const char*>(&name), sizeof(name));
+    key.append(reinterpret_cast<const char*>(fields.data()), fields.size() * sizeof(TypeId));
+
+    std::lock_guard<std::mutex> guard(TypeTable::struct_lock);
+    auto find_it = TypeTable::struct_map.find(key);
+    if(find_it != TypeTable::struct_map.end())
+    {
+        return find_it->second;
+    }
+
+    size_t index = TypeTable::struct_count;
+    size_t chunk = index >> TypeTable::struct_chunk_bits;
+    if(chunk >= TypeTable::max_struct_chunks)
+    {
+        printf("Error: too many struct types\n");
+        exit(-1);
+    }
+    if(!TypeTable::struct_chunks[chunk])
+    {
+        TypeTable::struct_chunks[chunk] = unique_ptr<StructInfo[]>(new StructInfo[TypeTable::struct_chunk_size]);
+    }
+
+    //Laid out like a C struct, each field at its alignment and the size rounded up to the largest one
+    uint32_t size = 0;
+    uint32_t alignment = 1;
+    for(TypeId field: fields)
+    {
+        const TypeInfo& field_info = TypeTable::get(field);
+        size = (size + field_info.alignment - 1) / field_info.alignment * field_info.alignment + field_info.size;
+        alignment = std::max(alignment, field_info.alignment);
+    }
+    size = (size + alignment - 1) / alignment * alignment;
+
+    StructInfo& struct_info = TypeTable::struct_chunks[chunk][index & (TypeTable::struct_chunk_size - 1)];
+    struct_info.info = {TypeEnum::Struct, TypeClass::Struct, false, size * 8, size, alignment, StringCache::c_str(name)};
+    struct_info.fields = fields;
+    TypeTable::struct_count++;
+
+    TypeId id = (TypeId)(TypeTable::count + index);
+    TypeTable::struct_map.emplace(std::move(key), id);
+    return id;
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "containers.hpp"
+#include "string_cache.hpp"
+
+#include <mutex>
 
 enum class TypeClass
 {
@@ -29,221 +32,83 @@ enum class TypeEnum
     Struct,
 };
 
-class Type
-{
-public:
-    virtual TypeClass get_class() = 0;
-    virtual TypeEnum get_type() = 0;
-};
+typedef uint32_t TypeId;
 
-class VoidType: public Type
+//Everything the compiler needs to know about a type, computed once when the table is built
+struct TypeInfo
 {
-public:
-    TypeClass get_class() override { return TypeClass::Invalid; };
-    TypeEnum get_type() override { return TypeEnum::Void; };
+    TypeEnum type;
+    TypeClass type_class;
+    bool is_signed;
+    uint32_t size_in_bits;
+    uint32_t size;
+    uint32_t alignment;
+    const char* name;
 };
 
-class UnresolvedType: public Type
+//Canonical type table, every type exists once so two types are equal exactly when their ids are equal
+//Primitive ids are their TypeEnum value so they can be named without a lookup
+//Struct types are interned by name and field types as they are resolved and get the ids after the primitives
+//Until AstResolver runs the AST holds unresolved ids, the StringId of the written name with the top bit set
+class TypeTable
 {
 protected:
-    string name;
-
-public:
-    TypeClass get_class() override { return TypeClass::Invalid; };
-    TypeEnum get_type() override { return TypeEnum::Invalid; };
+    static const TypeId unresolved_flag = 0x80000000;
 
-    UnresolvedType(const string& name): name(name){};
-    string get_name() {return this->name; };
-};
+    static constexpr TypeInfo types[] =
+    {
+        {TypeEnum::Invalid, TypeClass::Invalid, false, 0, 0, 0, "invalid"},
+        {TypeEnum::Void, TypeClass::Invalid, false, 0, 0, 0, "void"},
+        {TypeEnum::Bool, TypeClass::Int, false, 1, 1, 1, "bool"},
+        {TypeEnum::Char8, TypeClass::Int, false, 8, 1, 1, "char"},
+        {TypeEnum::Uint8, TypeClass::Int, false, 8, 1, 1, "u8"},
+        {TypeEnum::Uint16, TypeClass::Int, false, 16, 2, 2, "u16"},
+        {TypeEnum::Uint32, TypeClass::Int, false, 32, 4, 4, "u32"},
+        {TypeEnum::Uint64, TypeClass::Int, false, 64, 8, 8, "u64"},
+        {TypeEnum::Int8, TypeClass::Int, true, 8, 1, 1, "i8"},
+        {TypeEnum::Int16, TypeClass::Int, true, 16, 2, 2, "i16"},
+        {TypeEnum::Int32, TypeClass::Int, true, 32, 4, 4, "i32"},
+        {TypeEnum::Int64, TypeClass::Int, true, 64, 8, 8, "i64"},
+        {TypeEnum::Float32, TypeClass::Float, true, 32, 4, 4, "f32"},
+        {TypeEnum::Float64, TypeClass::Float, true, 64, 8, 8, "f64"},
+    };
 
-class IntType: public Type
-{
-protected:
-    bool is_signed_int;
-    size_t number_of_bits;
-    TypeEnum type;
+    static const size_t struct_chunk_bits = 8;
+    static const size_t struct_chunk_size = 1 << struct_chunk_bits;
+    static const size_t max_struct_chunks = 1024;
 
-    void set(bool is_signed, size_t bits)
+    struct StructInfo
     {
-       this->is_signed_int = is_signed;
-       this->number_of_bits = bits;
+        TypeInfo info;
+        vector<TypeId> fields;
     };
-    
-public:
-    TypeClass get_class() override { return TypeClass::Int; };
-    TypeEnum get_type() override { return this->type; };
-    bool is_signed() { return this->is_signed_int; };
-    size_t size_in_bits() { return this->number_of_bits; };
 
-    IntType(TypeEnum type)
+    //Same layout as StringCache, structs never move once added so get() never has to lock
+    static std::mutex struct_lock;
+    static unordered_map<string, TypeId> struct_map;
+    static size_t struct_count;
+    static unique_ptr<StructInfo[]> struct_chunks[max_struct_chunks];
+
+    static const StructInfo& get_struct(TypeId id)
     {
-        this->type = type;
-        switch (this->type)
-        {
-            case TypeEnum::Bool:
-                this->set(false, 1);
-                break;
-            case TypeEnum::Char8:
-            case TypeEnum::Uint8:
-                this->set(false, 8);
-                break;
-            case TypeEnum::Uint16:
-                this->set(false, 16);
-                break;
-            case TypeEnum::Uint32:
-                this->set(false, 32);
-                break;
-            case TypeEnum::Uint64:
-                this->set(false, 64);
-                break;
-            case TypeEnum::Int8:
-                this->set(true, 8);
-                break;
-            case TypeEnum::Int16:
-                this->set(true, 16);
-                break;
-            case TypeEnum::Int32:
-                this->set(true, 32);
-                break;
-            case TypeEnum::Int64:
-                this->set(true, 64);
-                break;
-            default:
-                printf("Error: invalid int type!!!!!!!!!");
-        }
+        size_t index = id - count;
+        return struct_chunks[index >> struct_chunk_bits][index & (struct_chunk_size - 1)];
     };
-};
-
-class FloatType: public Type
-{
-protected:
-    //If true f32
-    //If false f64
-    bool f32;
 
 public:
-    TypeClass get_class() override { return TypeClass::Float; };
-    TypeEnum get_type() override { return this->f32 ? TypeEnum::Float32 : TypeEnum::Float64; };
-    FloatType(bool is_f32) { this->f32 = is_f32; };
-    bool is_f32() { return this->f32; };
-};
+    static const TypeId Invalid = 0;
+    //Number of primitive types, struct ids start here
+    static const size_t count = sizeof(types) / sizeof(types[0]);
 
-//TODO
-class StructType: public Type
-{
-protected:
-public:
-    TypeClass get_class() override { return TypeClass::Struct; };
-    TypeEnum get_type() override { return TypeEnum::Struct; };
-};
+    static TypeId get_id(TypeEnum type) { return (TypeId)type; };
+    static const TypeInfo& get(TypeId id) { return id < count ? types[id] : get_struct(id).info; };
+    static TypeClass get_class(TypeId id) { return get(id).type_class; };
 
-namespace TestType
-{
-    struct StructInfo;
+    //Returns the existing id if a struct with the same name and field types was added before
+    static TypeId add_struct(StringId name, const vector<TypeId>& fields);
+    static const vector<TypeId>& get_fields(TypeId id) { return get_struct(id).fields; };
 
-    class Type
-    {
-    protected:
-        TypeEnum type_enum;
-        union Data
-        {
-            string unresolved_name;
-            StructInfo* struct_ptr;
-        } data;
-
-    public:
-        TypeEnum get_type()
-        {
-            return this->type_enum;
-        }
-
-        TypeClass get_class()
-        {
-            switch (this->type_enum)
-            {
-                case TypeEnum::Void:
-                case TypeEnum::Invalid:
-                    return TypeClass::Invalid;
-                case TypeEnum::Bool://TODO figure this out
-                case TypeEnum::Char8:
-                case TypeEnum::Uint8:
-                case TypeEnum::Int8:
-                case TypeEnum::Uint16:
-                case TypeEnum::Int16:
-                case TypeEnum::Uint32:
-                case TypeEnum::Int32:
-                case TypeEnum::Uint64:
-                case TypeEnum::Int64:
-                    return TypeClass::Int;
-                case TypeEnum::Float32:
-                case TypeEnum::Float64:
-                    return TypeClass::Float;
-                case TypeEnum::Struct:
-                    return TypeClass::Struct;
-            }
-        };
-
-        bool int_is_signed()
-        {
-            switch (this->type_enum)
-            {
-                case TypeEnum::Int8:
-                case TypeEnum::Int16:
-                case TypeEnum::Int32:
-                case TypeEnum::Int64:
-                    return true;
-                default:
-                    return false;
-            }
-        };
-
-        /*size_t get_size_bytes()
-        {
-            switch (this->type_enum)
-            {
-                case TypeEnum::Void:
-                case TypeEnum::Invalid:
-                    return 0;
-                case TypeEnum::Bool://TODO figure this out
-                case TypeEnum::Char8:
-                case TypeEnum::Uint8:
-                case TypeEnum::Int8:
-                    return 1;
-                case TypeEnum::Uint16:
-                case TypeEnum::Int16:
-                    return 2;
-                case TypeEnum::Uint32:
-                case TypeEnum::Int32:
-                case TypeEnum::Float32:
-                    return 4;
-                case TypeEnum::Uint64:
-                case TypeEnum::Int64:
-                case TypeEnum::Float64:
-                    return 8;
-                case TypeEnum::Struct:
-                    return 0;//TODO
-            }
-        };*/
-
-        //Compare
-        bool operator== (Type const& other)
-        {
-            if(this->type_enum == other.type_enum)
-            {
-                if(this->type_enum == TypeEnum::Invalid)
-                {
-                    //Compare names
-                    return this->data.unresolved_name == other.data.unresolved_name;
-                }
-                else if (this->type_enum == TypeEnum::Struct)
-                {
-                    return false;//TODO compare structs
-                }
-
-                //Type is not struct or invalid and has same type
-                return true;
-            }
-            return false;
-        };
-    };
-}
\ No newline at end of file
+    static TypeId unresolved(StringId name) { return name | unresolved_flag; };
+    static bool is_resolved(TypeId id) { return (id & unresolved_flag) == 0; };
+    static StringId get_unresolved_name(TypeId id) { return id & ~unresolved_flag; };
+};
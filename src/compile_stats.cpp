@@ -0,0 +1,98 @@
+#include "compile_stats.hpp"
+
+#include "string_cache.hpp"
+
+#include <algorithm>
+#include <sys/resource.h>
+
+//Only the largest functions are listed, the total covers all of them
+static const size_t max_printed_functions = 10;
+
+CompileStats::CompileStats(const string& file_name)
+:file_name(file_name)
+{
+}
+
+void CompileStats::record_module(Module* module)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->tokens = module->token_count;
+    this->node_arrays.clear();
+    module->for_each_node_array([this](const char* name, auto& nodes)
+    {
+        this->node_arrays.push_back({name, nodes.size(), nodes.capacity() * sizeof(nodes[0])});
+    });
+}
+
+void CompileStats::record_peak_rss(const char* phase)
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->peak_rss.push_back({phase, (size_t)usage.ru_maxrss});
+}
+
+void CompileStats::add_function_instructions(string_view name, size_t count)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->function_instructions.push_back({string(name), count});
+}
+
+void CompileStats::print(FILE* out)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    fprintf(out, "===== Stats: %s =====\n", this->file_name.c_str());
+    fprintf(out, "tokens: %zu\n", this->tokens);
+
+    fprintf(out, "ast nodes:\n");
+    size_t total_bytes = 0;
+    for(const NodeArray& node_array: this->node_arrays)
+    {
+        fprintf(out, "  %-28s %10zu nodes %12zu bytes\n", node_array.name, node_array.count, node_array.bytes);
+        total_bytes += node_array.bytes;
+    }
+    fprintf(out, "  %-28s %10s       %12zu bytes\n", "total", "", total_bytes);
+
+    fprintf(out, "scope tables:\n");
+    size_t resolver_lookups = this->resolver_scope_lookups;
+    size_t codegen_lookups = this->codegen_scope_lookups;
+    fprintf(out, "  resolver %12zu lookups %12zu probes %6.2f probes/lookup\n", resolver_lookups, (size_t)this->resolver_scope_probes,
+            resolver_lookups ? (double)this->resolver_scope_probes / resolver_lookups : 0.0);
+    fprintf(out, "  codegen  %12zu lookups %12zu probes %6.2f probes/lookup\n", codegen_lookups, (size_t)this->codegen_scope_probes,
+            codegen_lookups ? (double)this->codegen_scope_probes / codegen_lookups : 0.0);
+
+    size_t total_instructions = 0;
+    for(const FunctionInstructions& function: this->function_instructions)
+    {
+        total_instructions += function.count;
+    }
+    fprintf(out, "llvm instructions: %zu in %zu functions\n", total_instructions, this->function_instructions.size());
+
+    vector<FunctionInstructions> largest = this->function_instructions;
+    std::sort(largest.begin(), largest.end(), [](const FunctionInstructions& a, const FunctionInstructions& b) { return a.count > b.count; });
+    if(largest.size() > max_printed_functions)
+    {
+        largest.resize(max_printed_functions);
+    }
+    for(const FunctionInstructions& function: largest)
+    {
+        fprintf(out, "  %10zu %s\n", function.count, function.name.c_str());
+    }
+
+    fprintf(out, "peak rss:\n");
+    for(auto& phase: this->peak_rss)
+    {
+        fprintf(out, "  after %-20s %10zu KB\n", phase.first, phase.second);
+    }
+    fprintf(out, "\n");
+}
+
+void CompileStats::print_string_cache(FILE* out)
+{
+    StringCacheStats stats = StringCache::get_stats();
+    fprintf(out, "===== Stats: string cache =====\n");
+    fprintf(out, "symbols: %zu\n", stats.symbols);
+    fprintf(out, "lookups: %zu, %.1f%% hits\n", stats.lookups, stats.lookups ? 100.0 * (stats.lookups - stats.symbols) / stats.lookups : 0.0);
+    fprintf(out, "bytes: %zu\n", stats.bytes);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "containers.hpp"
+#include "ast/module.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <string_view>
+
+using std::string_view;
+
+//Counters from every subsystem of one file for --stats, meant to show which structure grew on a large input
+//Function bodies may be resolved on worker threads, so everything they add to is atomic or locked
+class CompileStats
+{
+public:
+    CompileStats(const string& file_name);
+
+    std::atomic<size_t> resolver_scope_lookups{0};
+    std::atomic<size_t> resolver_scope_probes{0};
+    std::atomic<size_t> codegen_scope_lookups{0};
+    std::atomic<size_t> codegen_scope_probes{0};
+
+    //Tokens and the count and reserved size of every AST node array, taken once the AST is complete
+    void record_module(Module* module);
+
+    //Peak RSS of the whole process so far, so phases of files compiled in parallel overlap
+    void record_peak_rss(const char* phase);
+
+    void add_function_instructions(string_view name, size_t count);
+
+    void print(FILE* out);
+
+    //The string cache is shared by every file, so it is reported once
+    static void print_string_cache(FILE* out);
+
+protected:
+    struct NodeArray
+    {
+        const char* name;
+        size_t count;
+        size_t bytes;
+    };
+
+    struct FunctionInstructions
+    {
+        string name;
+        size_t count;
+    };
+
+    string file_name;
+    std::mutex lock;
+    size_t tokens = 0;
+    vector<NodeArray> node_arrays;
+    vector<std::pair<const char*, size_t>> peak_rss;
+    vector<FunctionInstructions> function_instructions;
+};
@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <memory_resource>
 #include <unordered_map>
 
 using std::vector;
@@ -0,0 +1,621 @@
+#include "driver.hpp"
+
+#include "parse_context.hpp"
+#include "ast/ast_resolver.hpp"
+#include "streaming_compiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//foo/bar.c_not -> foo/bar.o
+static string get_object_file_name(const string& file_name)
+{
+    size_t extension = file_name.find_last_of('.');
+    size_t directory = file_name.find_last_of('/');
+    if(extension == string::npos || (directory != string::npos && extension < directory))
+    {
+        return file_name + ".o";
+    }
+    return file_name.substr(0, extension) + ".o";
+}
+
+static bool is_number(const char* text)
+{
+    if(*text == '\0')
+    {
+        return false;
+    }
+
+    for(; *text != '\0'; text++)
+    {
+        if(*text < '0' || *text > '9')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+Driver::Driver(const DriverOptions& options)
+:options(options), failed(false)
+{
+}
+
+bool Driver::parse_arguments(int argc, char** argv, DriverOptions& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const char* argument = argv[i];
+        if(strcmp(argument, "--stream") == 0)
+        {
+            options.streaming = true;
+        }
+        else if(parse_optimization_level(argument, options.optimization_level)) {}
+        else if(parse_cpu_target(argument, options.cpu_target)) {}
+        else if(strncmp(argument, "--codegen-threads=", 18) == 0)
+        {
+            if(!is_number(argument + 18))
+            {
+                printf("Error: invalid codegen thread count %s\n", argument);
+                return false;
+            }
+            options.codegen_threads = strtoul(argument + 18, nullptr, 10);
+            if(options.codegen_threads == 0)
+            {
+                options.codegen_threads = std::max(std::thread::hardware_concurrency(), 1u);
+            }
+        }
+        else if(strncmp(argument, "--cache=", 8) == 0)
+        {
+            options.cache_directory = argument + 8;
+        }
+        else if(strcmp(argument, "--run") == 0)
+        {
+            options.run = true;
+        }
+        else if(strcmp(argument, "--lazy") == 0)
+        {
+            options.run = true;
+            options.lazy = true;
+        }
+        else if(strncmp(argument, "--runtime=", 10) == 0)
+        {
+            options.jit_options.libraries.push_back(argument + 10);
+        }
+        else if(strcmp(argument, "--perf") == 0 || strcmp(argument, "--perf=jitdump") == 0)
+        {
+            options.jit_options.perf_map = true;
+            options.jit_options.jitdump = argument[6] != '\0';
+            options.debug_info = true;
+        }
+        else if(strcmp(argument, "-g") == 0)
+        {
+            options.debug_info = true;
+        }
+        else if(strcmp(argument, "--watch") == 0)
+        {
+            options.watch = true;
+        }
+        else if(strcmp(argument, "--stats") == 0)
+        {
+            options.stats = true;
+        }
+        else if(strcmp(argument, "--time-report") == 0)
+        {
+            options.time_report = true;
+        }
+        else if(strncmp(argument, "--time-report-json=", 19) == 0)
+        {
+            options.time_report_json = argument + 19;
+        }
+        else if(strncmp(argument, "-j", 2) == 0)
+        {
+            //-jN, -j N, or a bare -j for every hardware thread
+            if(argument[2] != '\0')
+            {
+                if(!is_number(argument + 2))
+                {
+                    printf("Error: invalid job count %s\n", argument);
+                    return false;
+                }
+                options.thread_count = strtoul(argument + 2, nullptr, 10);
+            }
+            else if(i + 1 < argc && is_number(argv[i + 1]))
+            {
+                options.thread_count = strtoul(argv[++i], nullptr, 10);
+            }
+            else
+            {
+                options.thread_count = 0;
+            }
+        }
+        else if(argument[0] == '-')
+        {
+            printf("Error: unknown option %s\n", argument);
+            return false;
+        }
+        else
+        {
+            options.file_names.push_back(argument);
+        }
+    }
+
+    //Streaming generates whole modules as it parses and the reports are only printed at exit, which --watch never reaches
+    bool cached = options.watch || !options.cache_directory.empty();
+    if(cached && options.streaming)
+    {
+        printf("Error: --stream cannot be combined with --cache or --watch\n");
+        return false;
+    }
+    if(options.watch && (options.stats || options.time_report || !options.time_report_json.empty()))
+    {
+        printf("Error: --watch cannot be combined with --stats or --time-report\n");
+        return false;
+    }
+
+    if(options.file_names.empty())
+    {
+        options.file_names.push_back("test.c_not");
+    }
+
+    //Cached functions only exist as objects, and a program is one file with one main
+    if(options.run && (cached || options.file_names.size() != 1))
+    {
+        printf("Error: --run takes a single file and cannot be combined with --cache or --watch\n");
+        return false;
+    }
+    if(options.jit_options.perf_map && !options.run)
+    {
+        printf("Error: --perf needs --run or --lazy\n");
+        return false;
+    }
+    //Cache keys do not cover the lines functions start on
+    if(options.debug_info && cached)
+    {
+        printf("Error: -g cannot be combined with --cache or --watch\n");
+        return false;
+    }
+    if(options.lazy && options.streaming)
+    {
+        printf("Error: --lazy cannot be combined with --stream\n");
+        return false;
+    }
+
+    return true;
+}
+
+int Driver::run()
+{
+    vector<SourceFile*> files;
+    for(const string& file_name: this->options.file_names)
+    {
+        SourceFile* file = this->source_manager.open(file_name);
+        if(!file)
+        {
+            return -1;
+        }
+        files.push_back(file);
+    }
+
+    llvmModule::initialize_targets();
+
+    //Code the JIT runs never leaves this machine, so it may use everything the host has
+    if(this->options.run && this->options.cpu_target.cpu.empty())
+    {
+        this->options.cpu_target.cpu = "native";
+    }
+    this->options.cpu_target.in_process = this->options.run;
+    if(!llvmModule::set_cpu_target(this->options.cpu_target))
+    {
+        return -1;
+    }
+
+    if(this->options.time_report || !this->options.time_report_json.empty())
+    {
+        llvmModule::enable_pass_timing();
+        for(SourceFile* file: files)
+        {
+            this->time_reports.push_back(std::make_unique<TimeReport>(file->get_path()));
+        }
+    }
+
+    if(this->options.stats)
+    {
+        for(SourceFile* file: files)
+        {
+            this->stats.push_back(std::make_unique<CompileStats>(file->get_path()));
+        }
+    }
+
+    if(this->options.watch || !this->options.cache_directory.empty())
+    {
+        this->object_cache = std::make_unique<ObjectCache>(this->options.cache_directory);
+    }
+
+    if(this->options.watch)
+    {
+        return this->watch(files);
+    }
+
+    double start = TimeReport::get_wall_time();
+    int result = this->compile_files(files);
+    if(this->options.run && result == 0)
+    {
+        double compile_seconds = TimeReport::get_wall_time() - start - this->run_seconds;
+        fprintf(stderr, "Compiled in %.1f ms, ran in %.1f ms\n", compile_seconds * 1000.0, this->run_seconds * 1000.0);
+        result = this->program_result;
+    }
+    this->write_stats();
+    if(!this->write_time_reports() && result == 0)
+    {
+        result = -3;
+    }
+    return result;
+}
+
+int Driver::compile_files(const vector<SourceFile*>& files)
+{
+    if(this->options.thread_count == 1 || files.size() == 1)
+    {
+        unique_ptr<ThreadPool> function_pool;
+        if(this->options.thread_count != 1)
+        {
+            function_pool = std::make_unique<ThreadPool>(this->options.thread_count);
+        }
+
+        for(size_t i = 0; i < files.size(); i++)
+        {
+            if(!this->compile_file(files[i], i, function_pool.get()))
+            {
+                return -2;
+            }
+        }
+        return 0;
+    }
+
+    ThreadPool thread_pool(this->options.thread_count);
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        SourceFile* file = files[i];
+        thread_pool.add_job([this, file, i]()
+        {
+            if(!this->compile_file(file, i))
+            {
+                this->failed = true;
+            }
+        });
+    }
+    thread_pool.wait();
+
+    return this->failed ? -2 : 0;
+}
+
+static int64_t get_modification_time(const string& file_name)
+{
+    struct stat file_stat;
+    if(stat(file_name.c_str(), &file_stat) != 0)
+    {
+        return -1;
+    }
+    return (int64_t)file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec;
+}
+
+int Driver::watch(vector<SourceFile*>& files)
+{
+    //Polls modification times, a changed file is parsed and resolved again but only its changed functions are compiled
+    unique_ptr<ThreadPool> function_pool;
+    if(this->options.thread_count != 1)
+    {
+        function_pool = std::make_unique<ThreadPool>(this->options.thread_count);
+    }
+
+    vector<int64_t> modification_times(files.size());
+    vector<size_t> changed_files;
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        modification_times[i] = get_modification_time(files[i]->get_path());
+        changed_files.push_back(i);
+    }
+
+    while(true)
+    {
+        if(!changed_files.empty())
+        {
+            double start = TimeReport::get_wall_time();
+            size_t hits = this->object_cache->get_hits();
+            size_t misses = this->object_cache->get_misses();
+            bool built = true;
+            for(size_t index: changed_files)
+            {
+                built = this->compile_file(files[index], index, function_pool.get()) && built;
+            }
+            fprintf(stderr, "%s %zu file(s) in %.1f ms, %zu functions compiled, %zu reused\n", built ? "Built" : "Failed to build", changed_files.size(),
+                    (TimeReport::get_wall_time() - start) * 1000.0, this->object_cache->get_misses() - misses, this->object_cache->get_hits() - hits);
+            changed_files.clear();
+        }
+
+        usleep(100 * 1000);
+        for(size_t i = 0; i < files.size(); i++)
+        {
+            int64_t modification_time = get_modification_time(files[i]->get_path());
+            if(modification_time == modification_times[i] || modification_time < 0)
+            {
+                continue;
+            }
+
+            SourceFile* file = this->source_manager.open(files[i]->get_path());
+            if(file)
+            {
+                modification_times[i] = modification_time;
+                this->source_manager.close(files[i]);
+                files[i] = file;
+                changed_files.push_back(i);
+            }
+        }
+    }
+}
+
+bool Driver::compile_file(SourceFile* file, size_t file_index, ThreadPool* function_pool)
+{
+    if(this->options.streaming)
+    {
+        return this->stream_file(file, file_index);
+    }
+
+    const string& file_name = file->get_path();
+    TimeReport* time_report = this->get_time_report(file_index);
+    CompileStats* stats = this->get_stats(file_index);
+
+    unique_ptr<Module> module_ast;
+    {
+        TimeReport::Timer timer(time_report, "parse");
+        module_ast = parse_source_file(file);
+    }
+    if(!module_ast)
+    {
+        fprintf(stderr, "Failed to parse file %s\n", file_name.c_str());
+        return false;
+    }
+    module_ast->name = file_name;
+    if(stats != nullptr)
+    {
+        stats->record_module(module_ast.get());
+        stats->record_peak_rss("parse");
+    }
+
+    //Bodies are resolved as they are first called
+    if(this->options.lazy)
+    {
+        return this->run_lazy(file, module_ast.get(), file_index, function_pool);
+    }
+
+    //Resolve types, functions, consts, etc
+    {
+        TimeReport::Timer timer(time_report, "resolve");
+        if(!AstResolver(time_report, stats).resolve(module_ast.get(), function_pool))
+        {
+            return false;
+        }
+    }
+    if(stats != nullptr)
+    {
+        stats->record_peak_rss("resolve");
+    }
+
+    if(this->object_cache)
+    {
+        //Functions are generated one at a time inside the cache, so there is no whole module to print
+        bool compiled;
+        {
+            TimeReport::Timer timer(time_report, "compile");
+            compiled = llvmModule::compile_functions(get_object_file_name(file_name), module_ast.get(), this->options.optimization_level, this->object_cache.get(), function_pool, time_report);
+        }
+        if(stats != nullptr)
+        {
+            stats->record_peak_rss("compile");
+        }
+        return compiled;
+    }
+
+    unique_ptr<llvmModule> module;
+    {
+        TimeReport::Timer timer(time_report, "codegen");
+        module = std::make_unique<llvmModule>(file_name, module_ast.get(), true, time_report, stats, this->options.debug_info ? file : nullptr);
+    }
+    if(stats != nullptr)
+    {
+        stats->record_peak_rss("codegen");
+    }
+    return this->emit_module(*module, file_name, file_index);
+}
+
+bool Driver::stream_file(SourceFile* file, size_t file_index)
+{
+    const string& file_name = file->get_path();
+    TimeReport* time_report = this->get_time_report(file_index);
+    CompileStats* stats = this->get_stats(file_index);
+
+    Module module_ast;
+    module_ast.name = file_name;
+    StreamingCompiler compiler(file_name, &module_ast, time_report, stats, this->options.debug_info ? file : nullptr);
+
+    //Resolve and codegen happen inside the parse, they show up as its children
+    {
+        TimeReport::Timer timer(time_report, "parse");
+        if(!parse_source_file(file, &module_ast, [&compiler](Module*) { compiler.top_level_parsed(); }))
+        {
+            fprintf(stderr, "Failed to parse file %s\n", file_name.c_str());
+            return false;
+        }
+    }
+    if(stats != nullptr)
+    {
+        stats->record_peak_rss("parse and stream");
+    }
+
+    {
+        TimeReport::Timer timer(time_report, "deferred functions");
+        if(!compiler.finish())
+        {
+            return false;
+        }
+    }
+
+    if(stats != nullptr)
+    {
+        //The arrays only hold what was kept, their capacity shows how large they got
+        stats->record_module(&module_ast);
+        stats->record_peak_rss("deferred functions");
+    }
+
+    return this->emit_module(compiler.get_llvm_module(), file_name, file_index);
+}
+
+bool Driver::emit_module(llvmModule& module, const string& file_name, size_t file_index)
+{
+    TimeReport* time_report = this->get_time_report(file_index);
+    CompileStats* stats = this->get_stats(file_index);
+    if(stats != nullptr)
+    {
+        module.count_instructions(stats);
+    }
+
+    //Bad IR is reported here rather than handed to the optimizer or the backend
+    if(!module.verify())
+    {
+        return false;
+    }
+
+    if(this->options.run)
+    {
+        return this->run_module(module, file_index);
+    }
+
+    {
+        TimeReport::Timer timer(time_report, "print");
+        std::lock_guard<std::mutex> guard(this->output_lock);
+        module.print_code();
+        printf("\n");
+    }
+    //module.write_to_file("module.bc");
+    {
+        TimeReport::Timer timer(time_report, "compile");
+        if(!module.compile(get_object_file_name(file_name), this->options.optimization_level, this->options.codegen_threads))
+        {
+            return false;
+        }
+    }
+    if(stats != nullptr)
+    {
+        stats->record_peak_rss("compile");
+    }
+    return true;
+}
+
+bool Driver::run_module(llvmModule& module, size_t file_index)
+{
+    TimeReport* time_report = this->get_time_report(file_index);
+    CompileStats* stats = this->get_stats(file_index);
+
+    //No IR is printed, stdout belongs to the program
+    llvmModule::MainFunction main_function;
+    {
+        TimeReport::Timer timer(time_report, "compile");
+        main_function = module.jit_compile(this->options.optimization_level, this->options.jit_options);
+    }
+    if(main_function == nullptr)
+    {
+        return false;
+    }
+    if(stats != nullptr)
+    {
+        stats->record_peak_rss("compile");
+    }
+    return this->run_main(main_function, file_index);
+}
+
+bool Driver::run_lazy(SourceFile* file, Module* module_ast, size_t file_index, ThreadPool* function_pool)
+{
+    TimeReport* time_report = this->get_time_report(file_index);
+    llvmLazyJit jit(module_ast->name, module_ast, this->options.optimization_level, function_pool, time_report, this->options.debug_info ? file : nullptr);
+
+    llvmModule::MainFunction main_function;
+    {
+        TimeReport::Timer timer(time_report, "compile");
+        main_function = jit.initialize(this->options.jit_options) ? jit.get_main() : nullptr;
+    }
+    if(main_function == nullptr)
+    {
+        return false;
+    }
+
+    //The run time includes compiling every function the program calls
+    if(!this->run_main(main_function, file_index))
+    {
+        return false;
+    }
+    fprintf(stderr, "Compiled %zu of %zu functions\n", jit.get_compiled_count(), jit.get_function_count());
+    return true;
+}
+
+bool Driver::run_main(llvmModule::MainFunction main_function, size_t file_index)
+{
+    double start = TimeReport::get_wall_time();
+    {
+        TimeReport::Timer timer(this->get_time_report(file_index), "run");
+        this->program_result = main_function();
+    }
+    this->run_seconds = TimeReport::get_wall_time() - start;
+
+    //The program writes through the same stdio, flushed so its output comes before the timings
+    fflush(stdout);
+    return true;
+}
+
+void Driver::write_stats()
+{
+    if(!this->options.stats)
+    {
+        return;
+    }
+
+    for(unique_ptr<CompileStats>& file_stats: this->stats)
+    {
+        file_stats->print(stderr);
+    }
+    CompileStats::print_string_cache(stderr);
+}
+
+bool Driver::write_time_reports()
+{
+    if(this->options.time_report)
+    {
+        for(unique_ptr<TimeReport>& time_report: this->time_reports)
+        {
+            time_report->print(stderr);
+        }
+    }
+
+    if(!this->options.time_report_json.empty())
+    {
+        FILE* file = fopen(this->options.time_report_json.c_str(), "w");
+        if(file == nullptr)
+        {
+            printf("Error: cannot open %s\n", this->options.time_report_json.c_str());
+            return false;
+        }
+
+        fprintf(file, "[\n");
+        for(size_t i = 0; i < this->time_reports.size(); i++)
+        {
+            this->time_reports[i]->print_json(file);
+            fprintf(file, i + 1 < this->time_reports.size() ? ",\n" : "\n");
+        }
+        fprintf(file, "]\n");
+        fclose(file);
+    }
+    return true;
+}
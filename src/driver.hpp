@@ -0,0 +1,98 @@
+#pragma once
+
+#include "containers.hpp"
+#include "source_manager.hpp"
+#include "thread_pool.hpp"
+#include "time_report.hpp"
+#include "compile_stats.hpp"
+#include "llvm/llvm_code_gen.hpp"
+#include "llvm/llvm_lazy_jit.hpp"
+#include "llvm/llvm_jit.hpp"
+
+#include <atomic>
+#include <mutex>
+
+struct DriverOptions
+{
+    vector<string> file_names;
+
+    //Number of threads used, 0 means one per hardware thread
+    size_t thread_count = 1;
+
+    //Resolve and generate each function as soon as it is parsed instead of after the whole file
+    bool streaming = false;
+
+    //--time-report prints the time of every phase to stderr, --time-report-json=<file> writes it as JSON
+    bool time_report = false;
+    string time_report_json;
+
+    //--stats prints counters and peak memory of every subsystem to stderr
+    bool stats = false;
+
+    OptimizationLevel optimization_level = OptimizationLevel::O0;
+
+    //--cache=<dir> compiles every function on its own and keeps its object in dir, so later runs only compile functions that changed
+    string cache_directory;
+
+    //Rebuilds whenever an input file changes, with the object cache kept in memory between rebuilds
+    bool watch = false;
+
+    //--run compiles in memory with the JIT and calls main instead of writing an object file
+    bool run = false;
+
+    //--lazy runs with each function compiled on its first call, and with -j its callees speculatively in the background
+    bool lazy = false;
+
+    //--runtime=<library> adds a library searched for externs before the ToyC process, --perf and --perf=jitdump tell perf about the JIT's code
+    JitOptions jit_options;
+
+    //-g gives every function debug info with the line it starts on, --perf turns it on too
+    bool debug_info = false;
+
+    //-march=<cpu>, -mcpu=<cpu> and -mattr=<features> pick what code is generated for, -march=native the host, which is also what --run defaults to
+    CpuTarget cpu_target;
+
+    //--codegen-threads=N splits each optimized module in N partitions emitted in parallel, 0 means one per hardware thread
+    size_t codegen_threads = 1;
+};
+
+//Runs every input file through parse, resolve, codegen and object emission
+//Each file is independent so with -j they are compiled on a thread pool, a single file spreads its function bodies over it instead
+class Driver
+{
+public:
+    Driver(const DriverOptions& options);
+
+    static bool parse_arguments(int argc, char** argv, DriverOptions& options);
+
+    int run();
+
+protected:
+    DriverOptions options;
+    SourceManager source_manager;
+    std::mutex output_lock;
+    std::atomic<bool> failed;
+    unique_ptr<ObjectCache> object_cache;
+
+    //What main returned with --run, which becomes ToyC's exit code, and how long it ran
+    int program_result = 0;
+    double run_seconds = 0.0;
+
+    //One per input file when enabled, in the order the files were given
+    vector<unique_ptr<TimeReport>> time_reports;
+    vector<unique_ptr<CompileStats>> stats;
+
+    TimeReport* get_time_report(size_t file_index) { return this->time_reports.empty() ? nullptr : this->time_reports[file_index].get(); };
+    CompileStats* get_stats(size_t file_index) { return this->stats.empty() ? nullptr : this->stats[file_index].get(); };
+
+    int compile_files(const vector<SourceFile*>& files);
+    int watch(vector<SourceFile*>& files);
+    bool compile_file(SourceFile* file, size_t file_index, ThreadPool* function_pool = nullptr);
+    bool stream_file(SourceFile* file, size_t file_index);
+    bool emit_module(llvmModule& module, const string& file_name, size_t file_index);
+    bool run_module(llvmModule& module, size_t file_index);
+    bool run_lazy(SourceFile* file, Module* module_ast, size_t file_index, ThreadPool* function_pool);
+    bool run_main(llvmModule::MainFunction main_function, size_t file_index);
+    bool write_time_reports();
+    void write_stats();
+};
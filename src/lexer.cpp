@@ -0,0 +1,300 @@
+#include "lexer.hpp"
+
+#include "string_cache.hpp"
+#include "ast/module.hpp"
+#include "parser.hpp"
+
+#include <cstring>
+#include <stdio.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LEXER_CHUNK_SIZE 32
+typedef __m256i Chunk;
+static inline Chunk chunk_load(const char* data) { return _mm256_loadu_si256((const __m256i*)data); }
+static inline Chunk chunk_equal(Chunk chunk, char value) { return _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(value)); }
+static inline Chunk chunk_or(Chunk lhs, Chunk rhs) { return _mm256_or_si256(lhs, rhs); }
+static inline uint32_t chunk_mask(Chunk chunk) { return (uint32_t)_mm256_movemask_epi8(chunk); }
+//Bytes are compared as signed, so anything >= 0x80 is never in range
+static inline Chunk chunk_in_range(Chunk chunk, char low, char high)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(chunk, _mm256_set1_epi8(low - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), chunk));
+}
+static const uint32_t chunk_full_mask = 0xFFFFFFFF;
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LEXER_CHUNK_SIZE 16
+typedef __m128i Chunk;
+static inline Chunk chunk_load(const char* data) { return _mm_loadu_si128((const __m128i*)data); }
+static inline Chunk chunk_equal(Chunk chunk, char value) { return _mm_cmpeq_epi8(chunk, _mm_set1_epi8(value)); }
+static inline Chunk chunk_or(Chunk lhs, Chunk rhs) { return _mm_or_si128(lhs, rhs); }
+static inline uint32_t chunk_mask(Chunk chunk) { return (uint32_t)_mm_movemask_epi8(chunk); }
+//Bytes are compared as signed, so anything >= 0x80 is never in range
+static inline Chunk chunk_in_range(Chunk chunk, char low, char high)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(low - 1)), _mm_cmplt_epi8(chunk, _mm_set1_epi8(high + 1)));
+}
+static const uint32_t chunk_full_mask = 0xFFFF;
+#endif
+
+static inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline bool is_identifier_start(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+//Each skip function returns the first byte not in its class
+//The source is followed by zero bytes, which are in no class, so these never run off the end of the padding
+#ifdef LEXER_CHUNK_SIZE
+static inline const char* skip_matching(const char* position, uint32_t mask)
+{
+    return position + __builtin_ctz(~mask);
+}
+
+static const char* skip_whitespace(const char* position)
+{
+    while(true)
+    {
+        Chunk chunk = chunk_load(position);
+        Chunk matches = chunk_or(chunk_or(chunk_equal(chunk, ' '), chunk_equal(chunk, '\n')), chunk_or(chunk_or(chunk_equal(chunk, '\t'), chunk_equal(chunk, '\r')), chunk_equal(chunk, '\f')));
+        uint32_t mask = chunk_mask(matches);
+        if(mask != chunk_full_mask)
+        {
+            return skip_matching(position, mask);
+        }
+        position += LEXER_CHUNK_SIZE;
+    }
+}
+
+static const char* skip_digits(const char* position)
+{
+    while(true)
+    {
+        uint32_t mask = chunk_mask(chunk_in_range(chunk_load(position), '0', '9'));
+        if(mask != chunk_full_mask)
+        {
+            return skip_matching(position, mask);
+        }
+        position += LEXER_CHUNK_SIZE;
+    }
+}
+
+static const char* skip_identifier(const char* position)
+{
+    while(true)
+    {
+        Chunk chunk = chunk_load(position);
+        Chunk matches = chunk_or(chunk_or(chunk_in_range(chunk, 'a', 'z'), chunk_in_range(chunk, 'A', 'Z')), chunk_or(chunk_in_range(chunk, '0', '9'), chunk_equal(chunk, '_')));
+        uint32_t mask = chunk_mask(matches);
+        if(mask != chunk_full_mask)
+        {
+            return skip_matching(position, mask);
+        }
+        position += LEXER_CHUNK_SIZE;
+    }
+}
+#else
+static inline bool is_whitespace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f';
+}
+
+static inline bool is_identifier(char c)
+{
+    return is_identifier_start(c) || is_digit(c);
+}
+
+static const char* skip_whitespace(const char* position)
+{
+    while(is_whitespace(*position)) { position++; }
+    return position;
+}
+
+static const char* skip_digits(const char* position)
+{
+    while(is_digit(*position)) { position++; }
+    return position;
+}
+
+static const char* skip_identifier(const char* position)
+{
+    while(is_identifier(*position)) { position++; }
+    return position;
+}
+#endif
+
+void Lexer::begin(SourceFile* file)
+{
+    this->file = file;
+    this->position = file->get_data();
+    this->end = file->get_data() + file->get_size();
+    this->token_start = this->position;
+}
+
+int Lexer::next_token(YYSTYPE* value)
+{
+    this->position = skip_whitespace(this->position);
+    this->token_start = this->position;
+
+    if(this->position >= this->end)
+    {
+        return 0;
+    }
+
+    char c = *this->position;
+    if(is_identifier_start(c))
+    {
+        return this->identifier_token(value);
+    }
+
+    if(is_digit(c) || (c == '-' && is_digit(this->position[1])))
+    {
+        return this->number_token(value);
+    }
+
+    this->position++;
+    switch (c)
+    {
+        case ';': return SEMI;
+        case '(': return LPAREN;
+        case ')': return RPAREN;
+        case '{': return LBRACE;
+        case '}': return RBRACE;
+        case '[': return LBRACK;
+        case ']': return RBRACK;
+        case '.': return DOT;
+        case ',': return COMMA;
+        case '@': return AT;
+        case '+': return ADD;
+        case '-': return SUB;
+        case '*': return MUL;
+        case '/': return DIV;
+        case '%': return MOD;
+        case '<':
+            if(*this->position == '=') { this->position++; return LESS_EQUAL; }
+            return LARROW;
+        case '>':
+            if(*this->position == '=') { this->position++; return GREATER_EQUAL; }
+            return RARROW;
+        case '=':
+            if(*this->position == '=') { this->position++; return EQUAL; }
+            return ASSIGN;
+        case '!':
+            if(*this->position == '=') { this->position++; return NOT_EQUAL; }
+            break;
+        default:
+            break;
+    }
+
+    SourceLocation location = this->get_location();
+    printf("%s:%u:%u: Unknown token!\n\n", this->file->get_path().c_str(), location.line, location.column);
+    return 0;
+}
+
+int Lexer::identifier_token(YYSTYPE* value)
+{
+    this->position = skip_identifier(this->position + 1);
+    size_t length = this->position - this->token_start;
+    const char* text = this->token_start;
+
+    switch (length)
+    {
+        case 2:
+            if(memcmp(text, "if", 2) == 0) { return IF; }
+            if(memcmp(text, "do", 2) == 0) { return DO; }
+            break;
+        case 3:
+            if(memcmp(text, "for", 3) == 0) { return FOR; }
+            break;
+        case 4:
+            if(memcmp(text, "else", 4) == 0) { return ELSE; }
+            break;
+        case 5:
+            if(memcmp(text, "while", 5) == 0) { return WHILE; }
+            if(memcmp(text, "break", 5) == 0) { return BREAK; }
+            break;
+        case 6:
+            if(memcmp(text, "struct", 6) == 0) { return STRUCT; }
+            if(memcmp(text, "return", 6) == 0) { return RETURN; }
+            break;
+        case 8:
+            if(memcmp(text, "continue", 8) == 0) { return CONTINUE; }
+            break;
+        default:
+            break;
+    }
+
+    value->string_id = StringCache::add(text, length);
+    return IDENTIFIER;
+}
+
+int Lexer::number_token(YYSTYPE* value)
+{
+    const char* digits = this->token_start;
+    if(*digits == '-')
+    {
+        digits++;
+    }
+    this->position = skip_digits(digits);
+
+    //Same as the flex rule, a float needs at least one digit after the dot
+    if(*this->position == '.' && is_digit(this->position[1]))
+    {
+        this->position = skip_digits(this->position + 1);
+
+        //The mapped source is not null terminated after the token, so strtod gets a copy of all of it
+        string token(this->token_start, this->position);
+        value->double_val = strtod(token.c_str(), nullptr);
+        return FLOAT;
+    }
+
+    //Anything that could overflow goes through strtol so the result matches the flex scanner exactly
+    size_t digit_count = this->position - digits;
+    if(digit_count > 18)
+    {
+        string token(this->token_start, this->position);
+        value->int_val = strtol(token.c_str(), nullptr, 10);
+        return INTEGER;
+    }
+
+    long number = 0;
+    for(const char* digit = digits; digit < this->position; digit++)
+    {
+        number = number * 10 + (*digit - '0');
+    }
+    value->int_val = digits != this->token_start ? -number : number;
+    return INTEGER;
+}
+
+#ifdef TOYC_SIMD_LEXER
+void* lexer_create(SourceFile* file)
+{
+    Lexer* lexer = new Lexer();
+    lexer->begin(file);
+    return lexer;
+}
+
+void lexer_destroy(void* scanner)
+{
+    delete (Lexer*)scanner;
+}
+
+int yylex(YYSTYPE* value, void* scanner)
+{
+    return ((Lexer*)scanner)->next_token(value);
+}
+
+SourceLocation lexer_location(void* scanner)
+{
+    return ((Lexer*)scanner)->get_location();
+}
+
+uint32_t lexer_offset(void* scanner)
+{
+    return ((Lexer*)scanner)->get_offset();
+}
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "source_manager.hpp"
+
+union YYSTYPE;
+
+//Hand written replacement for the flex scanner in tokens.l, produces the same token stream
+//Whitespace, identifier and number runs are classified 16 or 32 bytes at a time with SSE2/AVX2
+class Lexer
+{
+public:
+    void begin(SourceFile* file);
+    int next_token(YYSTYPE* value);
+
+    SourceFile* get_file() { return this->file; };
+    SourceLocation get_location() { return this->file->get_location(this->token_start); };
+    uint32_t get_offset() { return (uint32_t)(this->token_start - this->file->get_data()); };
+
+protected:
+    SourceFile* file = nullptr;
+    const char* position = nullptr;
+    const char* end = nullptr;
+    const char* token_start = nullptr;
+
+    int identifier_token(YYSTYPE* value);
+    int number_token(YYSTYPE* value);
+};
+
+//Scanners are reentrant, each one carries its own state so files can be lexed on several threads at once
+//Implemented by tokens.l, or by lexer.cpp when built with TOYC_SIMD_LEXER
+
+//Creates a scanner over a mapped source file, the file must stay open until lexer_destroy
+void* lexer_create(SourceFile* file);
+void lexer_destroy(void* scanner);
+int yylex(YYSTYPE* value, void* scanner);
+
+//Location of the token the scanner returned last
+SourceLocation lexer_location(void* scanner);
+
+//Byte offset of the token the scanner returned last, unlike the location it costs nothing to take
+uint32_t lexer_offset(void* scanner);
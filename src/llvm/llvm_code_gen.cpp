@@ -1,33 +1,153 @@
 #include "llvm/llvm_code_gen.hpp"
+#include "llvm/llvm_jit.hpp"
 
-#include "scope_block.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
 
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Pass.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Passes/StandardInstrumentations.h>
+#include <llvm/Support/Timer.h>
 #include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/ADT/Optional.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/IR/GlobalIFunc.h>
+#include <llvm/IR/Verifier.h>
 #include <llvm/Support/Host.h>
+#include <llvm/Support/X86TargetParser.h>
+#include <llvm/MC/MCSubtargetInfo.h>
 #include <llvm/Support/TargetRegistry.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Support/Program.h>
+
+bool parse_optimization_level(const char* argument, OptimizationLevel& level)
+{
+    static const std::pair<const char*, OptimizationLevel> levels[] =
+    {
+        {"-O0", OptimizationLevel::O0},
+        {"-O1", OptimizationLevel::O1},
+        {"-O2", OptimizationLevel::O2},
+        {"-O3", OptimizationLevel::O3},
+        {"-Os", OptimizationLevel::Os},
+    };
+
+    for(auto& pair: levels)
+    {
+        if(strcmp(argument, pair.first) == 0)
+        {
+            level = pair.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_cpu_target(const char* argument, CpuTarget& target)
+{
+    if(strncmp(argument, "-march=", 7) == 0 || strncmp(argument, "-mcpu=", 6) == 0)
+    {
+        target.cpu = strchr(argument, '=') + 1;
+        return true;
+    }
+
+    if(strncmp(argument, "-mattr=", 7) == 0)
+    {
+        target.features += target.features.empty() || argument[7] == '\0' ? "" : ",";
+        target.features += argument + 7;
+        return true;
+    }
+    return false;
+}
+
+static llvm::CodeGenOpt::Level get_codegen_level(OptimizationLevel level)
+{
+    switch (level)
+    {
+        case OptimizationLevel::O0:
+            return llvm::CodeGenOpt::None;
+        case OptimizationLevel::O1:
+            return llvm::CodeGenOpt::Less;
+        case OptimizationLevel::O3:
+            return llvm::CodeGenOpt::Aggressive;
+        default:
+            return llvm::CodeGenOpt::Default;
+    }
+}
+
+static llvm::OptimizationLevel get_pipeline_level(OptimizationLevel level)
+{
+    switch (level)
+    {
+        case OptimizationLevel::O0:
+            return llvm::OptimizationLevel::O0;
+        case OptimizationLevel::O1:
+            return llvm::OptimizationLevel::O1;
+        case OptimizationLevel::O2:
+            return llvm::OptimizationLevel::O2;
+        case OptimizationLevel::O3:
+            return llvm::OptimizationLevel::O3;
+        case OptimizationLevel::Os:
+            return llvm::OptimizationLevel::Os;
+    }
+    return llvm::OptimizationLevel::O0;
+}
+
+static llvm::StringRef get_name(StringId id)
+{
+    string_view name = StringCache::get(id);
+    return llvm::StringRef(name.data(), name.size());
+}
+
+static const llvm::DataLayout& get_host_data_layout();
 
-llvmModule::llvmModule(const string& module_name, Module* module)
+llvmModule::llvmModule(const string& module_name, Module* module, bool generate_all, TimeReport* time_report, CompileStats* stats, SourceFile* debug_source)
 {
+    this->ast = module;
+    this->time_report = time_report;
+    this->stats = stats;
     this->context = std::make_unique<llvm::LLVMContext>();
     this->module = std::make_unique<llvm::Module>(module_name, *this->context);
 
-    for(auto& struct_object: module->structs)
+    //Set now so codegen knows type sizes, compiling sets it again from the target it emits for
+    this->module->setDataLayout(get_host_data_layout());
+
+    if(debug_source != nullptr)
     {
-        this->generate_struct(struct_object);
+        //Only line tables, variables and types have no debug info
+        this->debug_source = debug_source;
+        this->debug_builder = std::make_unique<llvm::DIBuilder>(*this->module);
+        llvm::SmallString<256> directory;
+        llvm::sys::fs::current_path(directory);
+        this->debug_file = this->debug_builder->createFile(debug_source->get_path(), directory);
+        this->debug_builder->createCompileUnit(llvm::dwarf::DW_LANG_C, this->debug_file, "ToyC", false, "", 0, "", llvm::DICompileUnit::LineTablesOnly);
+        this->module->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+        this->module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+    }
+
+    if(!generate_all)
+    {
+        return;
     }
 
-    ScopeBlock global_block(nullptr);
+    for(Struct& struct_object: module->structs)
+    {
+        this->generate_struct(struct_object);
+    }
 
     for(size_t i = 0; i < module->extern_functions.size(); i++)
     {
@@ -46,24 +166,28 @@ llvmModule::llvmModule(const string& module_name, Module* module)
     }
 }
 
-llvm::Type* llvmModule::getType(shared_ptr<Type> type)
+//Defined here so the header only needs LLJIT declared
+llvmModule::~llvmModule() = default;
+
+llvm::Type* llvmModule::getType(TypeId type)
 {
-    auto type_it = this->type_map.find(type);
-    if(type_it == this->type_map.end())
+    //Struct ids come after the primitives, the map only grows as far as the ids this module uses
+    if(type >= this->type_map.size())
+    {
+        this->type_map.resize(type + 1);
+    }
+
+    if(this->type_map[type] == nullptr)
     {
+        const TypeInfo& type_info = TypeTable::get(type);
         llvm::Type* llvm_type = nullptr;
-        switch (type->get_class())
+        switch (type_info.type_class)
         {
             case TypeClass::Int:
-            {
-                IntType* int_type = (IntType*)type.get();
-                llvm_type = llvm::Type::getIntNTy(*this->context, int_type->size_in_bits());
-            }
+                llvm_type = llvm::Type::getIntNTy(*this->context, type_info.size_in_bits);
                 break;
             case TypeClass::Float:
-            {
-                FloatType* float_type = (FloatType*)type.get();
-                if(float_type->is_f32())
+                if(type_info.type == TypeEnum::Float32)
                 {
                     llvm_type = llvm::Type::getFloatTy(*this->context);
                 }
@@ -71,13 +195,19 @@ llvm::Type* llvmModule::getType(shared_ptr<Type> type)
                 {
                     llvm_type = llvm::Type::getDoubleTy(*this->context);
                 }
-            }
                 break;
             case TypeClass::Struct:
-                //TODO: this
+            {
+                vector<llvm::Type*> field_types;
+                for(TypeId field: TypeTable::get_fields(type))
+                {
+                    field_types.push_back(this->getType(field));
+                }
+                llvm_type = llvm::StructType::create(*this->context, field_types, type_info.name);
+            }
                 break;
             case TypeClass::Invalid:
-                if(type->get_type() == TypeEnum::Void)
+                if(type_info.type == TypeEnum::Void)
                 {
                     llvm_type = llvm::Type::getVoidTy(*this->context);
                     break;
@@ -94,225 +224,490 @@ llvm::Type* llvmModule::getType(shared_ptr<Type> type)
 }
 
 
-void llvmModule::generate_struct(unique_ptr<Struct>& struct_object)
+void llvmModule::generate_struct(Struct& struct_object)
 {
-    vector<llvm::Type*> struct_types(struct_object->members.size());
-    for(size_t i = 0; i < struct_types.size(); i++)
-    {
-        struct_types[i] = this->getType(struct_object->members[i].type);
-    }
-
-    llvm::StructType* struct_type = llvm::StructType::create(*this->context, struct_types, struct_object->name);
+    //The resolver interned the struct, its llvm type is built from the table like any other
+    this->getType(struct_object.type);
 }
 
-llvm::Function* llvmModule::generate_extern_function(unique_ptr<ExternFunction>& function)
+llvm::Function* llvmModule::generate_extern_function(ExternFunction& function)
 {
-    llvm::Type* return_type = this->getType(function->return_type);
+    llvm::Type* return_type = this->getType(function.return_type);
     vector<llvm::BasicBlock*> llvm_basic_block_list;
     vector<llvm::Type*> arg_types;
 
-    arg_types.reserve(function->parameters.size());
-    for (int i = 0; i < function->parameters.size(); ++i)
+    arg_types.reserve(function.parameters.count);
+    for (FunctionParameter& parameter: this->ast->get_list(function.parameters))
     {
-        arg_types.push_back(this->getType(function->parameters[i].type));
+        arg_types.push_back(this->getType(parameter.type));
     }
 
     llvm::FunctionType* func_type = llvm::FunctionType::get(return_type, makeArrayRef(arg_types), false);
-    llvm::Function* llvm_function = llvm::Function::Create(func_type, llvm::GlobalValue::ExternalLinkage, function->name,*this->module);
+    llvm::Function* llvm_function = llvm::Function::Create(func_type, llvm::GlobalValue::ExternalLinkage, get_name(function.name),*this->module);
     llvm_function->setCallingConv(llvm::CallingConv::C);
     return llvm_function;
 }
 
-llvm::Function* llvmModule::generate_function_prototype(unique_ptr<Function>& function_node)
+llvm::Function* llvmModule::generate_function_prototype(Function& function_node)
 {
-    llvm::Type* return_type = this->getType(function_node->return_type);
+    llvm::Type* return_type = this->getType(function_node.return_type);
     vector<llvm::BasicBlock*> llvm_basic_block_list;
     vector<llvm::Type*> arg_types;
 
-    arg_types.reserve(function_node->parameters.size());
-    for (int i = 0; i < function_node->parameters.size(); ++i)
+    arg_types.reserve(function_node.parameters.count);
+    for (FunctionParameter& parameter: this->ast->get_list(function_node.parameters))
     {
-        arg_types.push_back(this->getType(function_node->parameters[i].type));
+        arg_types.push_back(this->getType(parameter.type));
     }
 
     llvm::FunctionType* func_type = llvm::FunctionType::get(return_type, makeArrayRef(arg_types), false);
-    llvm::Function* llvm_function = llvm::Function::Create(func_type, llvm::GlobalValue::ExternalLinkage, function_node->name,*this->module);
+    llvm::Function* llvm_function = llvm::Function::Create(func_type, llvm::GlobalValue::ExternalLinkage, get_name(function_node.name),*this->module);
     llvm_function->setCallingConv(llvm::CallingConv::C);
     return llvm_function;
 }
 
-void llvmModule::generate_function_body(llvm::Function* function, unique_ptr<Function>& function_node)
+void llvmModule::generate_function_body(llvm::Function* function, Function& function_node)
 {
+    TimeReport::Timer timer(this->time_report, StringCache::get(function_node.name));
+
     llvm::BasicBlock* llvm_block = llvm::BasicBlock::Create(*this->context, "entry", function);
     llvm::IRBuilder<> builder(llvm_block);
+    this->last_alloca = nullptr;
+
+    if(this->debug_builder)
+    {
+        //Everything in the function is attributed to the line it starts on, the AST has no positions for statements
+        uint32_t line = this->debug_source->get_location(function_node.offset).line;
+        llvm::DISubroutineType* type = this->debug_builder->createSubroutineType(this->debug_builder->getOrCreateTypeArray({}));
+        llvm::DISubprogram* subprogram = this->debug_builder->createFunction(this->debug_file, function->getName(), function->getName(), this->debug_file, line, type, line,
+                                                                             llvm::DINode::FlagPrototyped, llvm::DISubprogram::SPFlagDefinition);
+        function->setSubprogram(subprogram);
+        builder.SetCurrentDebugLocation(llvm::DILocation::get(*this->context, line, 0, subprogram));
+    }
+
+    if(function_node.target_clones.count != 0)
+    {
+        //Cloned once the module's target is known, see generate_target_clones
+        string targets;
+        for(StringId target: this->ast->get_list(function_node.target_clones))
+        {
+            targets += (targets.empty() ? "" : ",") + string(StringCache::get(target));
+        }
+        function->addFnAttr("toyc-target-clones", targets);
+    }
 
-    ScopeBlock function_scope(nullptr);
+    VariableTable variables;
+    VariableTable::Scope parameter_scope(&variables);
 
+    NodeSpan<FunctionParameter> parameters = this->ast->get_list(function_node.parameters);
     size_t i = 0;
     for (auto& argument : function->args())
     {
-        llvm::Type* variable_type = this->getType(function_node->parameters[i].type);
-        llvm::AllocaInst* alloc = builder.CreateAlloca(variable_type, nullptr, function_node->parameters[i].name);
+        llvm::Type* variable_type = this->getType(parameters[i].type);
+        llvm::AllocaInst* alloc = this->create_local(&builder, variable_type, parameters[i].name);
         builder.CreateStore(&argument, alloc);
-        function_scope.addLocalVariable(function_node->parameters[i].name, alloc);
+        variables.add(parameters[i].name, alloc);
         i++;
     }
 
-    if(this->generate_block(&builder, &function_scope, function_node->block) != BlockResult::Returned)
+    if(this->generate_block(&builder, &variables, function_node.block) == BlockResult::None)
+    {
+        //A function with a result that runs off its end has no value to return, like C calling that is undefined
+        if(function->getReturnType()->isVoidTy())
+        {
+            builder.CreateRet(nullptr);
+        }
+        else
+        {
+            builder.CreateUnreachable();
+        }
+    }
+
+    if(this->stats != nullptr)
     {
-        builder.CreateRet(nullptr);
+        this->stats->codegen_scope_lookups += variables.get_lookup_count();
+        this->stats->codegen_scope_probes += variables.get_probe_count();
     }
 }
 
-BlockResult llvmModule::generate_block(llvm::IRBuilder<>* builder, ScopeBlock* parent_scope, unique_ptr<Block>& block)
+llvm::Function* llvmModule::get_function(StringId name)
 {
-    llvm::IRBuilder<>* current_builder = builder;
-
-    ScopeBlock current_scope(parent_scope);
-    for(unique_ptr<Statement>& statement: block->statements)
+    llvm::Function* function = this->module->getFunction(get_name(name));
+    if(function == nullptr && this->declarations != nullptr)
     {
-        switch (statement->statement_type)
+        //A module holding a single function declares what it calls on first use
+        auto declaration = this->declarations->find(name);
+        if(declaration != this->declarations->end())
         {
-            case StatementType::Declaration:
+            if(declaration->second.function != nullptr)
             {
-                DeclarationStatement *declaration_node = (DeclarationStatement*) statement.get();
-                llvm::Type* variable_type = this->getType(declaration_node->type);
-
-                llvm::AllocaInst* alloc = current_builder->CreateAlloca(variable_type, nullptr, declaration_node->name);
-                current_scope.addLocalVariable(declaration_node->name, alloc);
-                if (declaration_node->expression) {
-                    llvm::Value *value = this->generate_expression(current_builder, &current_scope, declaration_node->expression);
-                    current_builder->CreateStore(value, alloc);
-                }
+                function = this->generate_function_prototype(*declaration->second.function);
             }
-                break;
-            case StatementType::Assignment:
+            else
             {
-                AssignmentStatement* assignment_node = (AssignmentStatement*)statement.get();
-                llvm::AllocaInst* variable = current_scope.getLocalVariable(assignment_node->name);
-                llvm::Value* value = this->generate_expression(current_builder, &current_scope, assignment_node->expression);
-                current_builder->CreateStore(value, variable);
+                function = this->generate_extern_function(*declaration->second.extern_function);
             }
-                break;
-            case StatementType::Block:
-                if(this->generate_block(current_builder, &current_scope, ((BlockStatement*)statement.get())->block) == BlockResult::Returned);
-                {
-                    return BlockResult::Returned;
-                }
-                break;
-            case StatementType::FunctionCall:
+        }
+    }
+    return function;
+}
+
+llvm::AllocaInst* llvmModule::create_local(llvm::IRBuilder<>* builder, llvm::Type* type, StringId name)
+{
+    //Placed after the allocas before it, like clang does, so the frame keeps declaration order
+    llvm::BasicBlock& entry = builder->GetInsertBlock()->getParent()->getEntryBlock();
+    llvm::IRBuilder<> entry_builder(&entry, this->last_alloca != nullptr ? std::next(this->last_alloca->getIterator()) : entry.begin());
+    this->last_alloca = entry_builder.CreateAlloca(type, nullptr, get_name(name));
+    return this->last_alloca;
+}
+
+llvm::ConstantInt* llvmModule::get_local_size(llvm::IRBuilder<>* builder, llvm::AllocaInst* local)
+{
+    return builder->getInt64(this->module->getDataLayout().getTypeAllocSize(local->getAllocatedType()));
+}
+
+BlockResult llvmModule::generate_block(llvm::IRBuilder<>* builder, VariableTable* variables, BlockId block)
+{
+    //Locals declared here, their lifetime ends with the block so stack coloring can share slots between sibling blocks
+    size_t outer_local_count = this->live_locals.size();
+
+    VariableTable::Scope block_scope(variables);
+    for(StatementRef statement: this->ast->get_block(block))
+    {
+        BlockResult result = this->generate_statement(builder, variables, statement);
+        if(result != BlockResult::None)
+        {
+            this->live_locals.resize(outer_local_count);
+            return result;
+        }
+    }
+
+    for(size_t i = this->live_locals.size(); i > outer_local_count; i--)
+    {
+        builder->CreateLifetimeEnd(this->live_locals[i - 1], this->get_local_size(builder, this->live_locals[i - 1]));
+    }
+    this->live_locals.resize(outer_local_count);
+    return BlockResult::None;
+}
+
+BlockResult llvmModule::generate_statement(llvm::IRBuilder<>* builder, VariableTable* variables, StatementRef statement)
+{
+    switch (statement.get_type())
+    {
+        case StatementType::Declaration:
+        {
+            DeclarationStatement& declaration_node = this->ast->get<DeclarationStatement>(statement);
+            llvm::Type* variable_type = this->getType(declaration_node.variable_type);
+
+            llvm::AllocaInst* alloc = this->create_local(builder, variable_type, declaration_node.name);
+            builder->CreateLifetimeStart(alloc, this->get_local_size(builder, alloc));
+            this->live_locals.push_back(alloc);
+            variables->add(declaration_node.name, alloc);
+            if (declaration_node.expression.is_valid()) {
+                llvm::Value *value = this->generate_expression(builder, variables, declaration_node.expression);
+                builder->CreateStore(value, alloc);
+            }
+        }
+            break;
+        case StatementType::Assignment:
+        {
+            AssignmentStatement& assignment_node = this->ast->get<AssignmentStatement>(statement);
+            llvm::AllocaInst* variable = *variables->find(assignment_node.name);
+            llvm::Value* value = this->generate_expression(builder, variables, assignment_node.expression);
+            builder->CreateStore(value, variable);
+        }
+            break;
+        case StatementType::Block:
+            return this->generate_block(builder, variables, this->ast->get<BlockStatement>(statement).block);
+        case StatementType::FunctionCall:
+        {
+            FunctionCallStatement& function_call = this->ast->get<FunctionCallStatement>(statement);
+            llvm::Function* called_function = this->get_function(function_call.function_name);
+            NodeSpan<ExpressionRef> argument_nodes = this->ast->get_list(function_call.arguments);
+            vector<llvm::Value*> arguments(argument_nodes.size());
+            for(size_t i = 0; i < argument_nodes.size(); i++)
             {
-                FunctionCallStatement* function_call = (FunctionCallStatement*)statement.get();
-                llvm::Function* called_function = this->module->getFunction(function_call->function_name);
-                vector<llvm::Value*> arguments(function_call->arguments.size());
-                for(size_t i = 0; i < function_call->arguments.size(); i++)
-                {
-                    arguments[i] = this->generate_expression(builder, &current_scope, function_call->arguments[i]);
-                }
-                current_builder->CreateCall(called_function, arguments);
+                arguments[i] = this->generate_expression(builder, variables, argument_nodes[i]);
             }
-                break;
-            case StatementType::If:
+            builder->CreateCall(called_function, arguments);
+        }
+            break;
+        case StatementType::If:
+        {
+            IfStatement& if_statement_node = this->ast->get<IfStatement>(statement);
+            llvm::Value* condition_value = this->generate_condition(builder, variables, if_statement_node.condition);
+            llvm::Function* function = builder->GetInsertBlock()->getParent();
+
+            // If only
+            if(if_statement_node.else_block == InvalidBlock)
             {
-                IfStatement* if_statement_node = (IfStatement*)statement.get();
-                llvm::Type* temp_type = llvm::Type::getInt32Ty(*this->context);//TODO dynamic if condition type
-                llvm::Value* condition_value = this->generate_expression(current_builder, &current_scope, if_statement_node->condition);
-                condition_value = current_builder->CreateICmpNE(condition_value, llvm::ConstantInt::get(temp_type, 0));
-                llvm::Function* function = current_builder->GetInsertBlock()->getParent();
-
-                // If only
-                if(!if_statement_node->else_block)
+                llvm::BasicBlock* if_block = llvm::BasicBlock::Create(builder->getContext(), "if_block", function);
+                llvm::BasicBlock* continue_block = llvm::BasicBlock::Create(builder->getContext(), "if_continue", function);
+
+                llvm::IRBuilder<> if_builder(if_block);
+                if_builder.SetCurrentDebugLocation(builder->getCurrentDebugLocation());
+                if(this->generate_block(&if_builder, variables, if_statement_node.if_block) == BlockResult::None)
                 {
-                    llvm::BasicBlock* if_block = llvm::BasicBlock::Create(current_builder->getContext(), "if_block", function);
-                    llvm::BasicBlock* continue_block = llvm::BasicBlock::Create(current_builder->getContext(), "if_continue", function);
+                    if_builder.CreateBr(continue_block);
+                }
 
-                    llvm::IRBuilder<> if_builder(if_block);
-                    if(this->generate_block(&if_builder, &current_scope, if_statement_node->if_block) != BlockResult::Returned)
-                    {
-                        if_builder.CreateBr(continue_block);
-                    }
+                builder->CreateCondBr(condition_value, if_block, continue_block);
+                builder->SetInsertPoint(continue_block);
+            }
+                // If Else
+            else
+            {
+                llvm::BasicBlock* if_block = llvm::BasicBlock::Create(builder->getContext(), "if_block", function);
+                llvm::BasicBlock* else_block = llvm::BasicBlock::Create(builder->getContext(), "else_block", function);
+                llvm::BasicBlock* continue_block = llvm::BasicBlock::Create(builder->getContext(), "if_continue", function);
 
-                    current_builder->CreateCondBr(condition_value, if_block, continue_block);
-                    current_builder->SetInsertPoint(continue_block);
+                llvm::IRBuilder<> if_builder(if_block);
+                if_builder.SetCurrentDebugLocation(builder->getCurrentDebugLocation());
+                if(this->generate_block(&if_builder, variables, if_statement_node.if_block) == BlockResult::None)
+                {
+                    if_builder.CreateBr(continue_block);
                 }
-                    // If Else
-                else
+
+                llvm::IRBuilder<> else_builder(else_block);
+                else_builder.SetCurrentDebugLocation(builder->getCurrentDebugLocation());
+                if(this->generate_block(&else_builder, variables, if_statement_node.else_block) == BlockResult::None)
                 {
-                    llvm::BasicBlock* if_block = llvm::BasicBlock::Create(current_builder->getContext(), "if_block", function);
-                    llvm::BasicBlock* else_block = llvm::BasicBlock::Create(current_builder->getContext(), "else_block", function);
-                    llvm::BasicBlock* continue_block = llvm::BasicBlock::Create(current_builder->getContext(), "if_continue", function);
-
-                    llvm::IRBuilder<> if_builder(if_block);
-                    if(this->generate_block(&if_builder, &current_scope, if_statement_node->if_block) != BlockResult::Returned)
-                    {
-                        if_builder.CreateBr(continue_block);
-                    }
-
-                    llvm::IRBuilder<> else_builder(else_block);
-                    if(this->generate_block(&else_builder, &current_scope, if_statement_node->else_block) != BlockResult::Returned)
-                    {
-                        else_builder.CreateBr(continue_block);
-                    }
-
-                    current_builder->CreateCondBr(condition_value, if_block, else_block);
-                    current_builder->SetInsertPoint(continue_block);
+                    else_builder.CreateBr(continue_block);
                 }
+
+                builder->CreateCondBr(condition_value, if_block, else_block);
+                builder->SetInsertPoint(continue_block);
             }
-                break;
-            case StatementType::While:
-                break;
-            case StatementType::Return:
+        }
+            break;
+        case StatementType::While:
+            return this->generate_loop(builder, variables, this->ast->get<WhileLoopStatement>(statement));
+        case StatementType::Jump:
+        {
+            //Locals declared inside the loop end here as they would at the end of their blocks, the loop's own init lives on
+            LoopTarget& loop = this->loops.back();
+            for(size_t i = this->live_locals.size(); i > loop.live_local_count; i--)
             {
-                ReturnStatement* return_statement = (ReturnStatement*)statement.get();
-                llvm::Value* return_value = nullptr;
-                if(return_statement->return_expression)
-                {
-                    return_value = this->generate_expression(current_builder, &current_scope, return_statement->return_expression);
-                }
-                current_builder->CreateRet(return_value);
-                return BlockResult::Returned;
+                builder->CreateLifetimeEnd(this->live_locals[i - 1], this->get_local_size(builder, this->live_locals[i - 1]));
+            }
+            bool is_break = this->ast->get<JumpStatement>(statement).jump == JumpType::Break;
+            loop.has_break |= is_break;
+            this->create_loop_branch(builder, is_break ? loop.break_block : loop.continue_block);
+            return BlockResult::Jumped;
+        }
+        case StatementType::Return:
+        {
+            ReturnStatement& return_statement = this->ast->get<ReturnStatement>(statement);
+            llvm::Value* return_value = nullptr;
+            if(return_statement.return_expression.is_valid())
+            {
+                return_value = this->generate_expression(builder, variables, return_statement.return_expression);
             }
+            builder->CreateRet(return_value);
+            return BlockResult::Returned;
+        }
+    }
+    return BlockResult::None;
+}
+
+//Self referencing llvm.loop node holding the hints, nullptr when the loop has none
+static llvm::MDNode* create_loop_id(llvm::LLVMContext& context, const LoopHints& hints)
+{
+    if(hints.unroll == LoopHints::none && hints.vectorize == LoopHints::none)
+    {
+        return nullptr;
+    }
+
+    llvm::TempMDTuple self = llvm::MDNode::getTemporary(context, llvm::None);
+    llvm::SmallVector<llvm::Metadata*, 4> operands = {self.get()};
+    auto add_hint = [&](const char* name, llvm::Metadata* value)
+    {
+        llvm::SmallVector<llvm::Metadata*, 2> hint = {llvm::MDString::get(context, name)};
+        if(value != nullptr)
+        {
+            hint.push_back(value);
+        }
+        operands.push_back(llvm::MDNode::get(context, hint));
+    };
+    auto constant = [&](llvm::Type* type, uint32_t value) { return llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(type, value)); };
+    llvm::Type* int_type = llvm::Type::getInt32Ty(context);
+    llvm::Type* bool_type = llvm::Type::getInt1Ty(context);
+
+    //A count of 1 turns the transform off, like clang's unroll(1) and vectorize_width(1)
+    if(hints.unroll == LoopHints::any)
+    {
+        add_hint("llvm.loop.unroll.full", nullptr);
+    }
+    else if(hints.unroll == 1)
+    {
+        add_hint("llvm.loop.unroll.disable", nullptr);
+    }
+    else if(hints.unroll != LoopHints::none)
+    {
+        add_hint("llvm.loop.unroll.count", constant(int_type, hints.unroll));
+    }
+
+    if(hints.vectorize == 1)
+    {
+        add_hint("llvm.loop.vectorize.width", constant(int_type, 1));
+    }
+    else if(hints.vectorize != LoopHints::none)
+    {
+        add_hint("llvm.loop.vectorize.enable", constant(bool_type, 1));
+        if(hints.vectorize != LoopHints::any)
+        {
+            add_hint("llvm.loop.vectorize.width", constant(int_type, hints.vectorize));
+        }
+    }
+
+    llvm::MDNode* loop_id = llvm::MDNode::getDistinct(context, operands);
+    loop_id->replaceOperandWith(0, loop_id);
+    return loop_id;
+}
+
+//Every loop has one header the condition is tested in, for a do while that is the body, which LLVM's loop passes rotate and unroll from there
+//while and for: condition -> body -> (step) -> condition, do while: body -> condition -> body, break jumps to the exit and continue to the step or condition
+//A loop whose condition is always true and that has no break only leaves through a return, so it counts as one and nothing follows it
+BlockResult llvmModule::generate_loop(llvm::IRBuilder<>* builder, VariableTable* variables, WhileLoopStatement& loop_node)
+{
+    llvm::LLVMContext& context = builder->getContext();
+    llvm::Function* function = builder->GetInsertBlock()->getParent();
+
+    //The init's variable is only visible in the loop and lives until the loop exits
+    size_t outer_local_count = this->live_locals.size();
+    VariableTable::Scope loop_scope(variables);
+    if(loop_node.init.is_valid())
+    {
+        this->generate_statement(builder, variables, loop_node.init);
+    }
+
+    llvm::BasicBlock* condition_block = nullptr;
+    llvm::BasicBlock* body_block = nullptr;
+    if(loop_node.test_first)
+    {
+        condition_block = llvm::BasicBlock::Create(context, "loop_condition", function);
+        body_block = llvm::BasicBlock::Create(context, "loop_body", function);
+    }
+    else
+    {
+        body_block = llvm::BasicBlock::Create(context, "loop_body", function);
+        condition_block = llvm::BasicBlock::Create(context, "loop_condition", function);
+    }
+    llvm::BasicBlock* step_block = loop_node.step.is_valid() ? llvm::BasicBlock::Create(context, "loop_step", function) : nullptr;
+    llvm::BasicBlock* exit_block = llvm::BasicBlock::Create(context, "loop_exit", function);
+
+    LoopTarget loop;
+    loop.header = loop_node.test_first ? condition_block : body_block;
+    loop.continue_block = step_block != nullptr ? step_block : condition_block;
+    loop.break_block = exit_block;
+    loop.live_local_count = this->live_locals.size();
+    loop.loop_id = create_loop_id(context, loop_node.hints);
+    loop.has_break = false;
+    this->loops.push_back(loop);
+
+    builder->CreateBr(loop.header);
+
+    llvm::IRBuilder<> condition_builder(condition_block);
+    condition_builder.SetCurrentDebugLocation(builder->getCurrentDebugLocation());
+    llvm::Value* condition_value = loop_node.condition.is_valid() ? this->generate_condition(&condition_builder, variables, loop_node.condition) : nullptr;
+    llvm::ConstantInt* constant_condition = llvm::dyn_cast_or_null<llvm::ConstantInt>(condition_value);
+    bool always_true = condition_value == nullptr || (constant_condition != nullptr && constant_condition->isOne());
+    if(always_true)
+    {
+        this->create_loop_branch(&condition_builder, body_block);
+    }
+    else
+    {
+        llvm::BranchInst* branch = condition_builder.CreateCondBr(condition_value, body_block, exit_block);
+        if(!loop_node.test_first && loop.loop_id != nullptr)
+        {
+            branch->setMetadata(llvm::LLVMContext::MD_loop, loop.loop_id);
         }
     }
+
+    llvm::IRBuilder<> body_builder(body_block);
+    body_builder.SetCurrentDebugLocation(builder->getCurrentDebugLocation());
+    if(this->generate_block(&body_builder, variables, loop_node.loop_block) == BlockResult::None)
+    {
+        this->create_loop_branch(&body_builder, loop.continue_block);
+    }
+
+    if(step_block != nullptr)
+    {
+        llvm::IRBuilder<> step_builder(step_block);
+        step_builder.SetCurrentDebugLocation(builder->getCurrentDebugLocation());
+        this->generate_statement(&step_builder, variables, loop_node.step);
+        this->create_loop_branch(&step_builder, condition_block);
+    }
+    bool has_break = this->loops.back().has_break;
+    this->loops.pop_back();
+
+    if(always_true && !has_break)
+    {
+        exit_block->eraseFromParent();
+        this->live_locals.resize(outer_local_count);
+        return BlockResult::Returned;
+    }
+
+    builder->SetInsertPoint(exit_block);
+    for(size_t i = this->live_locals.size(); i > outer_local_count; i--)
+    {
+        builder->CreateLifetimeEnd(this->live_locals[i - 1], this->get_local_size(builder, this->live_locals[i - 1]));
+    }
+    this->live_locals.resize(outer_local_count);
     return BlockResult::None;
 }
 
-llvm::Value* llvmModule::generate_expression(llvm::IRBuilder<>* builder, ScopeBlock* current_scope, unique_ptr<Expression>& expression)
+//Branches back to the header are the loop's latches, each one carries the hints so LLVM finds them whichever it keeps
+void llvmModule::create_loop_branch(llvm::IRBuilder<>* builder, llvm::BasicBlock* target)
+{
+    llvm::BranchInst* branch = builder->CreateBr(target);
+    const LoopTarget& loop = this->loops.back();
+    if(target == loop.header && loop.loop_id != nullptr)
+    {
+        branch->setMetadata(llvm::LLVMContext::MD_loop, loop.loop_id);
+    }
+}
+
+llvm::Value* llvmModule::generate_expression(llvm::IRBuilder<>* builder, VariableTable* variables, ExpressionRef expression)
 {
-    switch (expression->expression_type)
+    switch (expression.get_type())
     {
         case ExpressionType::ConstInt:
         {
-            ConstantIntegerExpression* int_node = (ConstantIntegerExpression*)expression.get();
-            IntType* int_type = (IntType*)int_node->int_type.get();
-            return llvm::ConstantInt::get(this->getType(int_node->int_type), int_node->value, int_type->is_signed());
+            ConstantIntegerExpression& int_node = this->ast->get<ConstantIntegerExpression>(expression);
+            return llvm::ConstantInt::get(this->getType(int_node.resolved_type), int_node.value, TypeTable::get(int_node.resolved_type).is_signed);
         }
         case ExpressionType::ConstFloat:
         {
-            ConstantDoubleExpression* const_float = (ConstantDoubleExpression*)expression.get();
-            return llvm::ConstantFP::get(this->getType(const_float->float_type), const_float->value);
+            ConstantDoubleExpression& const_float = this->ast->get<ConstantDoubleExpression>(expression);
+            return llvm::ConstantFP::get(this->getType(const_float.resolved_type), const_float.value);
         }
         case ExpressionType::Identifier:
-            return builder->CreateLoad(current_scope->getLocalVariable(((IdentifierExpression*)expression.get())->identifier_name), "load");
+        {
+            llvm::AllocaInst* variable = *variables->find(this->ast->get<IdentifierExpression>(expression).identifier_name);
+            return builder->CreateLoad(variable->getAllocatedType(), variable, "load");
+        }
         case ExpressionType::Function:
         {
-            FunctionCallExpression* function_call = (FunctionCallExpression*)expression.get();
-            llvm::Function* called_function = this->module->getFunction(function_call->function_name);
-            vector<llvm::Value*> arguments(function_call->arguments.size());
-            for(size_t i = 0; i < function_call->arguments.size(); i++)
+            FunctionCallExpression& function_call = this->ast->get<FunctionCallExpression>(expression);
+            llvm::Function* called_function = this->get_function(function_call.function_name);
+            NodeSpan<ExpressionRef> argument_nodes = this->ast->get_list(function_call.arguments);
+            vector<llvm::Value*> arguments(argument_nodes.size());
+            for(size_t i = 0; i < argument_nodes.size(); i++)
             {
-                arguments[i] = this->generate_expression(builder, current_scope, function_call->arguments[i]);
+                arguments[i] = this->generate_expression(builder, variables, argument_nodes[i]);
             }
 
             return builder->CreateCall(called_function, arguments);
         }
         case ExpressionType::BinaryOperator:
         {
-            BinaryOperatorExpression* bin_op = (BinaryOperatorExpression*)expression.get();
-            llvm::Value* lhs_value = this->generate_expression(builder, current_scope, bin_op->lhs);
-            llvm::Value* rhs_value = this->generate_expression(builder, current_scope, bin_op->rhs);
+            BinaryOperatorExpression& bin_op = this->ast->get<BinaryOperatorExpression>(expression);
+            llvm::Value* lhs_value = this->generate_expression(builder, variables, bin_op.lhs);
+            llvm::Value* rhs_value = this->generate_expression(builder, variables, bin_op.rhs);
 
-            switch (bin_op->binary_op)
+            switch (bin_op.binary_op)
             {
                 case BinaryOperator::Iadd:
                     return builder->CreateBinOp(llvm::Instruction::Add, lhs_value, rhs_value);
@@ -340,6 +735,40 @@ llvm::Value* llvmModule::generate_expression(llvm::IRBuilder<>* builder, ScopeBl
                 case BinaryOperator::Fmod:
                     return builder->CreateBinOp(llvm::Instruction::FRem, lhs_value, rhs_value);
 
+                case BinaryOperator::Ieq:
+                    return builder->CreateICmpEQ(lhs_value, rhs_value);
+                case BinaryOperator::Ine:
+                    return builder->CreateICmpNE(lhs_value, rhs_value);
+                case BinaryOperator::Ilt:
+                    return builder->CreateICmpSLT(lhs_value, rhs_value);
+                case BinaryOperator::Ile:
+                    return builder->CreateICmpSLE(lhs_value, rhs_value);
+                case BinaryOperator::Igt:
+                    return builder->CreateICmpSGT(lhs_value, rhs_value);
+                case BinaryOperator::Ige:
+                    return builder->CreateICmpSGE(lhs_value, rhs_value);
+                case BinaryOperator::Ult:
+                    return builder->CreateICmpULT(lhs_value, rhs_value);
+                case BinaryOperator::Ule:
+                    return builder->CreateICmpULE(lhs_value, rhs_value);
+                case BinaryOperator::Ugt:
+                    return builder->CreateICmpUGT(lhs_value, rhs_value);
+                case BinaryOperator::Uge:
+                    return builder->CreateICmpUGE(lhs_value, rhs_value);
+
+                case BinaryOperator::Feq:
+                    return builder->CreateFCmpOEQ(lhs_value, rhs_value);
+                case BinaryOperator::Fne:
+                    return builder->CreateFCmpUNE(lhs_value, rhs_value);
+                case BinaryOperator::Flt:
+                    return builder->CreateFCmpOLT(lhs_value, rhs_value);
+                case BinaryOperator::Fle:
+                    return builder->CreateFCmpOLE(lhs_value, rhs_value);
+                case BinaryOperator::Fgt:
+                    return builder->CreateFCmpOGT(lhs_value, rhs_value);
+                case BinaryOperator::Fge:
+                    return builder->CreateFCmpOGE(lhs_value, rhs_value);
+
                 case BinaryOperator::Function:
                     //TODO
                 default:
@@ -351,8 +780,56 @@ llvm::Value* llvmModule::generate_expression(llvm::IRBuilder<>* builder, ScopeBl
     return nullptr;
 }
 
+//Conditions are true when they are not zero of their own resolved type, a comparison's bool is used as it is
+llvm::Value* llvmModule::generate_condition(llvm::IRBuilder<>* builder, VariableTable* variables, ExpressionRef condition)
+{
+    llvm::Value* condition_value = this->generate_expression(builder, variables, condition);
+    if(condition_value->getType()->isIntegerTy(1))
+    {
+        return condition_value;
+    }
+    if(TypeTable::get_class(this->ast->get_resolved_type(condition)) == TypeClass::Float)
+    {
+        return builder->CreateFCmpONE(condition_value, llvm::ConstantFP::get(condition_value->getType(), 0.0));
+    }
+    return builder->CreateICmpNE(condition_value, llvm::ConstantInt::get(condition_value->getType(), 0));
+}
+
+void llvmModule::count_instructions(CompileStats* stats)
+{
+    for(llvm::Function& function: *this->module)
+    {
+        if(!function.isDeclaration())
+        {
+            llvm::StringRef name = function.getName();
+            stats->add_function_instructions(string_view(name.data(), name.size()), function.getInstructionCount());
+        }
+    }
+}
+
+void llvmModule::finish_debug_info()
+{
+    if(this->debug_builder)
+    {
+        this->debug_builder->finalize();
+        this->debug_builder.reset();
+    }
+}
+
+bool llvmModule::verify()
+{
+    this->finish_debug_info();
+    if(llvm::verifyModule(*this->module, &llvm::errs()))
+    {
+        llvm::errs() << "Error: generated invalid IR for " << this->module->getModuleIdentifier() << "\n";
+        return false;
+    }
+    return true;
+}
+
 void llvmModule::print_code()
 {
+    this->finish_debug_info();
     this->module->print(llvm::errs(), nullptr);
 }
 
@@ -366,7 +843,7 @@ void llvmModule::write_to_file(const string& file_name)
     OS.close();
 }
 
-void llvmModule::compile(const string &file_name)
+void llvmModule::initialize_targets()
 {
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmParser();
@@ -378,41 +855,781 @@ void llvmModule::compile(const string &file_name)
     llvm::InitializeAllTargetMCs();
     llvm::InitializeAllAsmParsers();
     llvm::InitializeAllAsmPrinters();*/
+}
 
-    auto TargetTriple =  llvm::sys::getDefaultTargetTriple();
-    this->module->setTargetTriple(TargetTriple);
+void llvmModule::enable_pass_timing()
+{
+    llvm::TimePassesIsEnabled = true;
+}
 
-    std::string Error;
-    auto Target =  llvm::TargetRegistry::lookupTarget(TargetTriple, Error);
-    if (!Target) {
-        llvm::errs() << Error;
-        return;
-    }
+//Resolved by set_cpu_target, so native has already become a real CPU name
+static string target_cpu = "generic";
+static string target_features;
+static bool target_in_process = false;
 
-    auto CPU = "generic";
-    auto Features = "";
+//LLVM only warns about names it doesn't know and aborts later in codegen, so they are checked up front
+static bool validate_cpu_target(const string& cpu, const string& features)
+{
+    string triple = llvm::sys::getDefaultTargetTriple();
+    string error;
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if(target == nullptr)
+    {
+        printf("Error: %s\n", error.c_str());
+        return false;
+    }
 
-    llvm::TargetOptions opt;
-    auto RM =  llvm::Optional< llvm::Reloc::Model>();
-    auto TheTargetMachine =
-            Target->createTargetMachine(TargetTriple, CPU, Features, opt, RM);
+    unique_ptr<llvm::MCSubtargetInfo> generic_info(target->createMCSubtargetInfo(triple, "", ""));
+    if(!generic_info->isCPUStringValid(cpu))
+    {
+        printf("Error: unknown CPU %s for %s\n", cpu.c_str(), triple.c_str());
+        return false;
+    }
 
-    this->module->setDataLayout(TheTargetMachine->createDataLayout());
+    //A known feature changes the CPU's feature bits when it is turned on or off, an unknown one is ignored
+    unique_ptr<llvm::MCSubtargetInfo> cpu_info(target->createMCSubtargetInfo(triple, cpu, ""));
+    llvm::SmallVector<llvm::StringRef, 16> feature_list;
+    llvm::StringRef(features).split(feature_list, ',', -1, false);
+    for(llvm::StringRef feature: feature_list)
+    {
+        if(feature.size() < 2 || (feature[0] != '+' && feature[0] != '-'))
+        {
+            printf("Error: feature %s must be +name or -name\n", feature.str().c_str());
+            return false;
+        }
 
-    auto Filename = "output.o";
-    std::error_code EC;
-    llvm::raw_fd_ostream dest(file_name, EC,  llvm::sys::fs::OF_None);
-    if (EC) {
-        llvm::errs() << "Could not open file: " << EC.message();
-        return;
+        string name = feature.drop_front().str();
+        unique_ptr<llvm::MCSubtargetInfo> enabled_info(target->createMCSubtargetInfo(triple, cpu, "+" + name));
+        if(enabled_info->getFeatureBits() != cpu_info->getFeatureBits())
+        {
+            continue;
+        }
+        unique_ptr<llvm::MCSubtargetInfo> disabled_info(target->createMCSubtargetInfo(triple, cpu, "-" + name));
+        if(disabled_info->getFeatureBits() == cpu_info->getFeatureBits())
+        {
+            printf("Error: unknown feature %s for %s\n", name.c_str(), triple.c_str());
+            return false;
+        }
     }
+    return true;
+}
 
-    llvm::legacy::PassManager pass;
-    auto FileType =  llvm::CGFT_ObjectFile;
-    if (TheTargetMachine->addPassesToEmitFile(pass, dest, nullptr, FileType)) {
+bool llvmModule::set_cpu_target(const CpuTarget& target)
+{
+    target_cpu = target.cpu.empty() ? "generic" : target.cpu;
+    target_features.clear();
+    target_in_process = target.in_process;
+    if(target.cpu == "native")
+    {
+        target_cpu = llvm::sys::getHostCPUName().str();
+
+        llvm::StringMap<bool> host_features;
+        if(llvm::sys::getHostCPUFeatures(host_features))
+        {
+            //Sorted so the same host always gives the same string, it is part of every object cache key
+            vector<string> feature_list;
+            for(auto& feature: host_features)
+            {
+                feature_list.push_back((feature.getValue() ? "+" : "-") + feature.getKey().str());
+            }
+            std::sort(feature_list.begin(), feature_list.end());
+            for(const string& feature: feature_list)
+            {
+                target_features += (target_features.empty() ? "" : ",") + feature;
+            }
+        }
+    }
+
+    if(!target.features.empty())
+    {
+        target_features += (target_features.empty() ? "" : ",") + target.features;
+    }
+
+    //The host's own features come from LLVM, only what was written on the command line needs checking
+    return validate_cpu_target(target_cpu, target.features);
+}
+
+void llvmModule::apply_cpu_target(llvm::orc::JITTargetMachineBuilder& machine_builder)
+{
+    machine_builder.setCPU(target_cpu);
+    machine_builder.getFeatures() = llvm::SubtargetFeatures(target_features);
+}
+
+//What a @target_clones body may be compiled for, the features __builtin_cpu_supports knows, with the bit libgcc's __cpu_indicator_init sets for each
+struct CloneFeature
+{
+    const char* name;
+    unsigned bit;
+    unsigned priority;
+};
+
+static const CloneFeature clone_features[] =
+{
+#define X86_FEATURE_COMPAT(ENUM, STRING, PRIORITY) {STRING, llvm::X86::FEATURE_##ENUM, PRIORITY},
+#include <llvm/Support/X86TargetParser.def>
+};
+
+static void add_target_feature(llvm::Function* function, const char* feature)
+{
+    string features = function->getFnAttribute("target-features").getValueAsString().str();
+    function->addFnAttr("target-features", features + (features.empty() ? "+" : ",+") + feature);
+}
+
+//Word of the CPU's feature bits as libgcc's __cpu_model and __cpu_features2 hold them, the same globals clang's resolvers read
+static llvm::Value* load_cpu_features(llvm::IRBuilder<>& builder, llvm::Module& module, unsigned word)
+{
+    llvm::Type* int_type = builder.getInt32Ty();
+    if(word == 0)
+    {
+        llvm::StructType* model_type = llvm::StructType::get(int_type, int_type, int_type, llvm::ArrayType::get(int_type, 1));
+        llvm::Constant* model = module.getOrInsertGlobal("__cpu_model", model_type);
+        return builder.CreateLoad(int_type, builder.CreateInBoundsGEP(model_type, model, {builder.getInt32(0), builder.getInt32(3), builder.getInt32(0)}));
+    }
+    return builder.CreateLoad(int_type, module.getOrInsertGlobal("__cpu_features2", int_type));
+}
+
+//Gives every function with @target_clones a body per target behind an ifunc named like the function, so calls pick the body once when the program loads
+//Code that runs in this process needs no ifunc, the function is compiled once for the best target this CPU has
+static bool generate_target_clones(llvm::Module& module)
+{
+    vector<llvm::Function*> functions;
+    for(llvm::Function& function: module)
+    {
+        if(function.hasFnAttribute("toyc-target-clones"))
+        {
+            functions.push_back(&function);
+        }
+    }
+
+    llvm::StringMap<bool> host_features;
+    if(target_in_process && !functions.empty())
+    {
+        llvm::sys::getHostCPUFeatures(host_features);
+    }
+
+    for(llvm::Function* function: functions)
+    {
+        string name = function->getName().str();
+        string targets = function->getFnAttribute("toyc-target-clones").getValueAsString().str();
+        function->removeFnAttr("toyc-target-clones");
+
+        vector<const CloneFeature*> clones;
+        bool has_default = false;
+        llvm::SmallVector<llvm::StringRef, 4> target_names;
+        llvm::StringRef(targets).split(target_names, ',');
+        for(llvm::StringRef target_name: target_names)
+        {
+            if(target_name == "default")
+            {
+                has_default = true;
+                continue;
+            }
+
+            const CloneFeature* clone = std::find_if(std::begin(clone_features), std::end(clone_features), [&](const CloneFeature& feature) { return target_name == feature.name; });
+            if(clone == std::end(clone_features))
+            {
+                llvm::errs() << "Error: unknown target " << target_name << " in @target_clones of " << name << "\n";
+                return false;
+            }
+            if(std::find(clones.begin(), clones.end(), clone) == clones.end())
+            {
+                clones.push_back(clone);
+            }
+        }
+
+        if(!has_default)
+        {
+            llvm::errs() << "Error: @target_clones of " << name << " needs a default target\n";
+            return false;
+        }
+        if(!clones.empty() && !llvm::Triple(module.getTargetTriple()).isX86())
+        {
+            llvm::errs() << "Error: @target_clones of " << name << " needs an x86 target\n";
+            return false;
+        }
+
+        //Lowest priority first, the resolver lets each supported target replace the one before it
+        std::sort(clones.begin(), clones.end(), [](const CloneFeature* a, const CloneFeature* b) { return a->priority < b->priority; });
+
+        if(target_in_process)
+        {
+            for(auto clone = clones.rbegin(); clone != clones.rend(); clone++)
+            {
+                if(host_features.lookup((*clone)->name))
+                {
+                    add_target_feature(function, (*clone)->name);
+                    break;
+                }
+            }
+            continue;
+        }
+
+        if(clones.empty())
+        {
+            continue;
+        }
+
+        function->setName(name + ".default");
+        function->setLinkage(llvm::GlobalValue::InternalLinkage);
+        vector<llvm::Function*> variants;
+        for(const CloneFeature* clone: clones)
+        {
+            llvm::ValueToValueMapTy values;
+            llvm::Function* variant = llvm::CloneFunction(function, values);
+            variant->setName(name + "." + clone->name);
+            add_target_feature(variant, clone->name);
+            variants.push_back(variant);
+        }
+
+        //Calls, recursive ones in the clones too, all go through the ifunc
+        llvm::FunctionType* type = function->getFunctionType();
+        llvm::Function* resolver = llvm::Function::Create(llvm::FunctionType::get(type->getPointerTo(), false), llvm::GlobalValue::InternalLinkage, name + ".resolver", module);
+        llvm::GlobalIFunc* ifunc = llvm::GlobalIFunc::create(type, 0, llvm::GlobalValue::ExternalLinkage, name, resolver, &module);
+        function->replaceAllUsesWith(ifunc);
+
+        //Resolvers run while the program is relocated, before the constructor that normally fills in __cpu_model
+        llvm::IRBuilder<> builder(llvm::BasicBlock::Create(module.getContext(), "entry", resolver));
+        builder.CreateCall(module.getOrInsertFunction("__cpu_indicator_init", builder.getVoidTy()));
+        llvm::Value* feature_words[2] = {};
+        llvm::Value* selected = function;
+        for(size_t i = 0; i < clones.size(); i++)
+        {
+            unsigned word = clones[i]->bit / 32;
+            if(feature_words[word] == nullptr)
+            {
+                feature_words[word] = load_cpu_features(builder, module, word);
+            }
+            llvm::Value* supported = builder.CreateAnd(feature_words[word], builder.getInt32(1u << (clones[i]->bit % 32)));
+            selected = builder.CreateSelect(builder.CreateICmpNE(supported, builder.getInt32(0)), variants[i], selected);
+        }
+        builder.CreateRet(selected);
+    }
+    return true;
+}
+
+//Like clang, every function carries its CPU so nothing after codegen falls back to generic, and the object's .comment names the target
+static bool set_module_target(llvm::Module& module)
+{
+    for(llvm::Function& function: module)
+    {
+        if(!function.isDeclaration())
+        {
+            function.addFnAttr("target-cpu", target_cpu);
+            if(!target_features.empty())
+            {
+                function.addFnAttr("target-features", target_features);
+            }
+        }
+    }
+
+    llvm::LLVMContext& context = module.getContext();
+    string ident = "ToyC target-cpu=" + target_cpu + (target_features.empty() ? "" : " target-features=" + target_features);
+    module.getOrInsertNamedMetadata("llvm.ident")->addOperand(llvm::MDNode::get(context, {llvm::MDString::get(context, ident)}));
+    return generate_target_clones(module);
+}
+
+static unique_ptr<llvm::TargetMachine> create_target_machine(const string& target_triple, OptimizationLevel optimization_level)
+{
+    std::string Error;
+    auto Target =  llvm::TargetRegistry::lookupTarget(target_triple, Error);
+    if (!Target) {
+        llvm::errs() << Error;
+        return nullptr;
+    }
+
+    auto CPU = target_cpu;
+    auto Features = target_features;
+
+    llvm::TargetOptions opt;
+    //Position independent like gcc's default PIE links expect, @target_clones resolvers hand out function addresses
+    auto RM =  llvm::Optional< llvm::Reloc::Model>(llvm::Reloc::PIC_);
+    return unique_ptr<llvm::TargetMachine>(Target->createTargetMachine(target_triple, CPU, Features, opt, RM, llvm::None, get_codegen_level(optimization_level)));
+}
+
+//The default triple's layout, which every target CPU of it shares
+static const llvm::DataLayout& get_host_data_layout()
+{
+    static const llvm::DataLayout data_layout = []()
+    {
+        unique_ptr<llvm::TargetMachine> target_machine = create_target_machine(llvm::sys::getDefaultTargetTriple(), OptimizationLevel::O0);
+        return target_machine ? target_machine->createDataLayout() : llvm::DataLayout("");
+    }();
+    return data_layout;
+}
+
+static bool emit_object(llvm::Module& module, llvm::TargetMachine* target_machine, llvm::raw_pwrite_stream& dest)
+{
+    llvm::legacy::PassManager pass;
+    auto FileType =  llvm::CGFT_ObjectFile;
+    if (target_machine->addPassesToEmitFile(pass, dest, nullptr, FileType)) {
         llvm::errs() << "TheTargetMachine can't emit a file of this type";
-        return;
+        return false;
     }
-    pass.run(*this->module);
+    pass.run(module);
     dest.flush();
-}
\ No newline at end of file
+    return true;
+}
+
+static bool emit_object(llvm::Module& module, llvm::TargetMachine* target_machine, const string& file_name)
+{
+    std::error_code EC;
+    llvm::raw_fd_ostream dest(file_name, EC,  llvm::sys::fs::OF_None);
+    if (EC) {
+        llvm::errs() << "Could not open file: " << EC.message();
+        return false;
+    }
+    return emit_object(module, target_machine, dest);
+}
+
+//Runs PassBuilder's default pipeline for optimization_level, instrumentation is only needed to time the passes
+static void optimize_module(llvm::Module& module, llvm::TargetMachine* target_machine, OptimizationLevel optimization_level, llvm::PassInstrumentationCallbacks* instrumentation)
+{
+    //Like clang, -Os also marks every function so the backend picks smaller sequences
+    if(optimization_level == OptimizationLevel::Os)
+    {
+        for(llvm::Function& function: module)
+        {
+            if(!function.isDeclaration())
+            {
+                function.addFnAttr(llvm::Attribute::OptimizeForSize);
+            }
+        }
+    }
+
+    llvm::LoopAnalysisManager loop_analysis;
+    llvm::FunctionAnalysisManager function_analysis;
+    llvm::CGSCCAnalysisManager cgscc_analysis;
+    llvm::ModuleAnalysisManager module_analysis;
+    llvm::PassBuilder pass_builder(target_machine, llvm::PipelineTuningOptions(), llvm::None, instrumentation);
+    pass_builder.registerModuleAnalyses(module_analysis);
+    pass_builder.registerCGSCCAnalyses(cgscc_analysis);
+    pass_builder.registerFunctionAnalyses(function_analysis);
+    pass_builder.registerLoopAnalyses(loop_analysis);
+    pass_builder.crossRegisterProxies(loop_analysis, function_analysis, cgscc_analysis, module_analysis);
+
+    llvm::ModulePassManager module_passes = pass_builder.buildPerModuleDefaultPipeline(get_pipeline_level(optimization_level));
+    module_passes.run(module, module_analysis);
+}
+
+//Links objects into one relocatable object with ld -r, the list goes through a response file since there can be thousands
+static bool merge_objects(const string& file_name, const vector<string>& object_files)
+{
+    llvm::ErrorOr<std::string> linker = llvm::sys::findProgramByName("ld");
+    if(!linker)
+    {
+        llvm::errs() << "Could not find ld to merge objects\n";
+        return false;
+    }
+
+    string response_file = file_name + ".objects";
+    {
+        std::error_code EC;
+        llvm::raw_fd_ostream response(response_file, EC, llvm::sys::fs::OF_None);
+        if (EC) {
+            llvm::errs() << "Could not open file: " << EC.message();
+            return false;
+        }
+        for(const string& object_file: object_files)
+        {
+            response << '"';
+            for(char character: object_file)
+            {
+                if(character == '"' || character == '\\')
+                {
+                    response << '\\';
+                }
+                response << character;
+            }
+            response << "\"\n";
+        }
+    }
+
+    string response_argument = "@" + response_file;
+    vector<llvm::StringRef> arguments = {"ld", "-r", "-o", file_name, response_argument};
+    string error;
+    int result = llvm::sys::ExecuteAndWait(*linker, arguments, llvm::None, {}, 0, 0, &error);
+    llvm::sys::fs::remove(response_file);
+    if(result != 0)
+    {
+        llvm::errs() << "Could not merge objects: " << error << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool llvmModule::compile(const string &file_name, OptimizationLevel optimization_level, size_t codegen_threads)
+{
+    this->finish_debug_info();
+    auto TargetTriple =  llvm::sys::getDefaultTargetTriple();
+    this->module->setTargetTriple(TargetTriple);
+
+    unique_ptr<llvm::TargetMachine> TheTargetMachine = create_target_machine(TargetTriple, optimization_level);
+    if(!TheTargetMachine)
+    {
+        return false;
+    }
+
+    this->module->setDataLayout(TheTargetMachine->createDataLayout());
+    if(!set_module_target(*this->module))
+    {
+        return false;
+    }
+
+    //The instrumentation holds the new pass manager's timers, it must outlive the pass timings read below
+    llvm::PassInstrumentationCallbacks instrumentation;
+    llvm::StandardInstrumentations standard_instrumentation(false);
+    standard_instrumentation.registerCallbacks(instrumentation);
+    if(optimization_level != OptimizationLevel::O0)
+    {
+        TimeReport::Timer timer(this->time_report, "optimize");
+        optimize_module(*this->module, TheTargetMachine.get(), optimization_level, &instrumentation);
+    }
+
+    //LLVM 14's module cloning drops ifuncs, so modules with @target_clones are emitted in one piece
+    bool emitted;
+    if(codegen_threads > 1 && this->module->ifunc_empty())
+    {
+        emitted = this->emit_partitions(file_name, optimization_level, codegen_threads);
+    }
+    else
+    {
+        TimeReport::Timer timer(this->time_report, "emit");
+        emitted = emit_object(*this->module, TheTargetMachine.get(), file_name);
+    }
+
+    if(this->time_report != nullptr)
+    {
+        //LLVM's timers are process wide, with several files compiling at once each report holds whatever ran since the last one
+        string text;
+        string json;
+        llvm::raw_string_ostream text_stream(text);
+        llvm::raw_string_ostream json_stream(json);
+        llvm::TimerGroup::printAll(text_stream);
+        llvm::TimerGroup::printAllJSONValues(json_stream, "");
+        llvm::TimerGroup::clearAll();
+        this->time_report->set_llvm_timings(text_stream.str(), json_stream.str());
+    }
+    return emitted;
+}
+
+bool llvmModule::emit_partitions(const string& file_name, OptimizationLevel optimization_level, size_t codegen_threads)
+{
+    //Partitions share this module's LLVMContext, which only one thread may use, so each goes through bitcode into a context of its own
+    vector<llvm::SmallString<0>> partitions;
+    {
+        TimeReport::Timer timer(this->time_report, "split");
+        llvm::SplitModule(*this->module, (unsigned)codegen_threads, [&partitions](unique_ptr<llvm::Module> partition)
+        {
+            partitions.emplace_back();
+            llvm::raw_svector_ostream stream(partitions.back());
+            llvm::WriteBitcodeToFile(*partition, stream);
+        });
+    }
+
+    vector<string> partition_files(partitions.size());
+    std::atomic<bool> failed(false);
+    {
+        TimeReport::Timer timer(this->time_report, "emit");
+        ThreadPool thread_pool(codegen_threads);
+        for(size_t i = 0; i < partitions.size(); i++)
+        {
+            partition_files[i] = file_name + ".part" + std::to_string(i) + ".o";
+            thread_pool.add_job([this, &partitions, &partition_files, &failed, i, optimization_level]()
+            {
+                double wall_start = TimeReport::get_wall_time();
+                double cpu_start = TimeReport::get_cpu_time();
+
+                llvm::LLVMContext context;
+                llvm::Expected<unique_ptr<llvm::Module>> partition = llvm::parseBitcodeFile(llvm::MemoryBufferRef(partitions[i], partition_files[i]), context);
+                unique_ptr<llvm::TargetMachine> target_machine;
+                if(!partition)
+                {
+                    llvm::errs() << "Could not read partition: " << llvm::toString(partition.takeError());
+                    failed = true;
+                }
+                else if(!(target_machine = create_target_machine((*partition)->getTargetTriple(), optimization_level))
+                    || !emit_object(**partition, target_machine.get(), partition_files[i]))
+                {
+                    failed = true;
+                }
+
+                if(this->time_report != nullptr)
+                {
+                    this->time_report->add("worker threads", TimeReport::get_wall_time() - wall_start, TimeReport::get_cpu_time() - cpu_start);
+                }
+            });
+        }
+        thread_pool.wait();
+    }
+
+    //The partitions that did emit are useless without the others, whatever stood in the way of a failed one is left alone
+    if(failed)
+    {
+        for(const string& partition_file: partition_files)
+        {
+            if(llvm::sys::fs::is_regular_file(partition_file))
+            {
+                llvm::sys::fs::remove(partition_file);
+            }
+        }
+        return false;
+    }
+
+    //Merged into one relocatable object so the output is the same file as without partitions
+    TimeReport::Timer timer(this->time_report, "merge");
+    if(!merge_objects(file_name, partition_files))
+    {
+        llvm::errs() << "Partitions are left as " << file_name << ".part*.o\n";
+        return false;
+    }
+
+    for(const string& partition_file: partition_files)
+    {
+        llvm::sys::fs::remove(partition_file);
+    }
+    return true;
+}
+
+string llvmModule::get_target(OptimizationLevel optimization_level)
+{
+    static const char* const level_names[] = {"O0", "O1", "O2", "O3", "Os"};
+    return llvm::sys::getDefaultTargetTriple() + "-" + target_cpu + "-" + target_features + "-" + level_names[(size_t)optimization_level];
+}
+
+string llvmModule::compile_to_memory(OptimizationLevel optimization_level)
+{
+    this->finish_debug_info();
+    string target_triple = llvm::sys::getDefaultTargetTriple();
+    this->module->setTargetTriple(target_triple);
+
+    unique_ptr<llvm::TargetMachine> target_machine = create_target_machine(target_triple, optimization_level);
+    if(!target_machine)
+    {
+        return string();
+    }
+    this->module->setDataLayout(target_machine->createDataLayout());
+    if(!set_module_target(*this->module))
+    {
+        return string();
+    }
+
+    if(optimization_level != OptimizationLevel::O0)
+    {
+        optimize_module(*this->module, target_machine.get(), optimization_level, nullptr);
+    }
+
+    llvm::SmallString<0> object;
+    llvm::raw_svector_ostream stream(object);
+    if(!emit_object(*this->module, target_machine.get(), stream))
+    {
+        return string();
+    }
+    return string(object.str());
+}
+
+llvmModule::MainFunction llvmModule::jit_compile(OptimizationLevel optimization_level, const JitOptions& options)
+{
+    this->finish_debug_info();
+    llvm::Expected<llvm::orc::JITTargetMachineBuilder> machine_builder = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if(!machine_builder)
+    {
+        llvm::errs() << "Could not detect the host: " << llvm::toString(machine_builder.takeError()) << "\n";
+        return nullptr;
+    }
+    machine_builder->setCodeGenOptLevel(get_codegen_level(optimization_level));
+    apply_cpu_target(*machine_builder);
+
+    llvm::Expected<unique_ptr<llvm::TargetMachine>> target_machine = machine_builder->createTargetMachine();
+    if(!target_machine)
+    {
+        llvm::errs() << "Could not create the JIT's target: " << llvm::toString(target_machine.takeError()) << "\n";
+        return nullptr;
+    }
+    this->module->setTargetTriple(machine_builder->getTargetTriple().str());
+    this->module->setDataLayout((*target_machine)->createDataLayout());
+    if(!set_module_target(*this->module))
+    {
+        return nullptr;
+    }
+
+    llvm::Function* main_function = this->module->getFunction("main");
+    if(main_function == nullptr || main_function->isDeclaration() || !main_function->getReturnType()->isIntegerTy(32) || main_function->arg_size() != 0)
+    {
+        llvm::errs() << "Error: running a program needs a function i32 main()\n";
+        return nullptr;
+    }
+
+    if(optimization_level != OptimizationLevel::O0)
+    {
+        TimeReport::Timer timer(this->time_report, "optimize");
+        optimize_module(*this->module, target_machine->get(), optimization_level, nullptr);
+    }
+
+    TimeReport::Timer timer(this->time_report, "jit");
+    this->jit = create_jit(std::move(*machine_builder), options);
+    if(!this->jit)
+    {
+        return nullptr;
+    }
+
+    llvm::Error error = this->jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(this->module), std::move(this->context)));
+    if(error)
+    {
+        llvm::errs() << "Could not add the module to the JIT: " << llvm::toString(std::move(error)) << "\n";
+        return nullptr;
+    }
+
+    //The module is only compiled and linked once something in it is looked up
+    llvm::Expected<llvm::JITEvaluatedSymbol> main_symbol = this->jit->lookup("main");
+    if(!main_symbol)
+    {
+        llvm::errs() << "Could not compile main: " << llvm::toString(main_symbol.takeError()) << "\n";
+        return nullptr;
+    }
+    return (MainFunction)main_symbol->getAddress();
+}
+
+llvmModule::FunctionDeclarations llvmModule::get_declarations(Module* module)
+{
+    FunctionDeclarations declarations;
+    for(ExternFunction& function: module->extern_functions)
+    {
+        declarations[function.name].extern_function = &function;
+    }
+    for(Function& function: module->functions)
+    {
+        declarations[function.name].function = &function;
+    }
+    return declarations;
+}
+
+string llvmModule::compile_function(const string& module_name, Module* module, Function& function, const FunctionDeclarations& declarations,
+                                    OptimizationLevel optimization_level, SourceFile* debug_source, vector<StringId>* callees)
+{
+    llvmModule function_module(module_name, module, false, nullptr, nullptr, debug_source);
+    function_module.declarations = &declarations;
+    function_module.generate_function_body(function_module.get_function(function.name), function);
+
+    if(callees != nullptr)
+    {
+        //Everything else the module declares was declared by a call
+        for(llvm::Function& declared: *function_module.module)
+        {
+            if(!declared.isDeclaration())
+            {
+                continue;
+            }
+            StringId name = StringCache::add(declared.getName().data(), declared.getName().size());
+            auto declaration = declarations.find(name);
+            if(declaration != declarations.end() && declaration->second.function != nullptr)
+            {
+                callees->push_back(name);
+            }
+        }
+    }
+
+    if(!function_module.verify())
+    {
+        return string();
+    }
+    return function_module.compile_to_memory(optimization_level);
+}
+
+bool llvmModule::compile_functions(const string& file_name, Module* module, OptimizationLevel optimization_level, ObjectCache* cache, ThreadPool* thread_pool, TimeReport* time_report)
+{
+    vector<string> keys;
+    {
+        TimeReport::Timer timer(time_report, "hash");
+        keys = ObjectCache::get_function_keys(module, get_target(optimization_level));
+    }
+
+    FunctionDeclarations declarations = get_declarations(module);
+
+    //Every function is generated into a module and context of its own, so misses can be compiled on any thread
+    vector<const string*> objects(module->functions.size());
+    std::atomic<bool> failed(false);
+    auto compile_function = [&](size_t index)
+    {
+        string object = llvmModule::compile_function(file_name, module, module->functions[index], declarations, optimization_level);
+        if(object.empty())
+        {
+            failed = true;
+            return;
+        }
+        objects[index] = cache->store(keys[index], std::move(object));
+    };
+
+    {
+        TimeReport::Timer timer(time_report, "compile functions");
+        for(size_t i = 0; i < objects.size(); i++)
+        {
+            objects[i] = cache->find(keys[i]);
+            if(objects[i] != nullptr)
+            {
+                continue;
+            }
+
+            if(thread_pool == nullptr)
+            {
+                compile_function(i);
+                continue;
+            }
+
+            thread_pool->add_job([&compile_function, time_report, i]()
+            {
+                double wall_start = TimeReport::get_wall_time();
+                double cpu_start = TimeReport::get_cpu_time();
+                compile_function(i);
+                if(time_report != nullptr)
+                {
+                    time_report->add("worker threads", TimeReport::get_wall_time() - wall_start, TimeReport::get_cpu_time() - cpu_start);
+                }
+            });
+        }
+        if(thread_pool != nullptr)
+        {
+            thread_pool->wait();
+        }
+    }
+
+    if(failed)
+    {
+        return false;
+    }
+
+    //ld needs at least one input
+    if(objects.empty())
+    {
+        return llvmModule(file_name, module).compile(file_name, optimization_level);
+    }
+
+    //Objects already on disk in the cache are linked from there, the rest are written out next to the output for ld
+    TimeReport::Timer timer(time_report, "merge");
+    vector<string> object_files;
+    vector<string> temporary_files;
+    for(size_t i = 0; i < objects.size(); i++)
+    {
+        string path = cache->get_path(keys[i]);
+        if(path.empty() || !llvm::sys::fs::exists(path))
+        {
+            path = file_name + ".function" + std::to_string(i) + ".o";
+            std::error_code EC;
+            llvm::raw_fd_ostream stream(path, EC, llvm::sys::fs::OF_None);
+            if (EC) {
+                llvm::errs() << "Could not open file: " << EC.message();
+                failed = true;
+                break;
+            }
+            stream << *objects[i];
+            temporary_files.push_back(path);
+        }
+        object_files.push_back(path);
+    }
+
+    bool merged = !failed && merge_objects(file_name, object_files);
+    for(const string& temporary_file: temporary_files)
+    {
+        llvm::sys::fs::remove(temporary_file);
+    }
+    return merged;
+}
@@ -2,38 +2,190 @@
 
 #include "containers.hpp"
 #include "ast/module.hpp"
-#include "llvm/scope_block.hpp"
+#include "scoped_symbol_table.hpp"
+#include "time_report.hpp"
+#include "compile_stats.hpp"
+#include "object_cache.hpp"
+#include "thread_pool.hpp"
+#include "source_manager.hpp"
 
 #include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
 
+namespace llvm::orc
+{
+    class LLJIT;
+    class JITTargetMachineBuilder;
+}
+struct JitOptions;
+
+//Local variables of the function being generated, each block opens a scope on it
+typedef ScopedSymbolTable<llvm::AllocaInst*> VariableTable;
+
+//Picks both the IR pass pipeline run before emission and the backend's codegen level
+enum class OptimizationLevel
+{
+    O0,
+    O1,
+    O2,
+    O3,
+    Os,
+};
+
+//Parses -O0, -O1, -O2, -O3 or -Os, returns false for anything else
+bool parse_optimization_level(const char* argument, OptimizationLevel& level);
+
+//CPU and extra features code is generated for, an empty cpu means generic, or the host when running in process
+struct CpuTarget
+{
+    //A name as in llc -mcpu, or native for the host
+    string cpu;
+
+    //Comma separated +feature/-feature list, later entries win
+    string features;
+
+    //The code runs in the compiling process, so @target_clones picks its body at compile time instead of with an ifunc
+    bool in_process = false;
+};
+
+//Parses -march=<cpu>, -mcpu=<cpu> and -mattr=<features>, the last cpu wins and features add up, returns false for anything else
+bool parse_cpu_target(const char* argument, CpuTarget& target);
+
+//How control leaves a block, only None falls through to the code after it
 enum class BlockResult
 {
     None,
     Returned,
+    Jumped,
 };
 
 class llvmModule
 {
 public:
-    llvmModule(const string& module_name, Module* module);
-    llvm::Type* getType(shared_ptr<Type> type);
+    //Entry point of a program compiled by jit_compile()
+    typedef int32_t (*MainFunction)();
+
+    //Generates every item of module, streaming passes false and generates items itself as they are resolved
+    //time_report gets a timer per function and LLVM's pass timings from compile()
+    //With a debug_source every function gets debug info pointing at the line it starts on in that file
+    llvmModule(const string& module_name, Module* module, bool generate_all = true, TimeReport* time_report = nullptr, CompileStats* stats = nullptr,
+               SourceFile* debug_source = nullptr);
+    ~llvmModule();
+
+    //Must be called once before any module is compiled, modules may then be built and compiled on any thread
+    static void initialize_targets();
+
+    //Turns on LLVM's own pass timers, must be called before any module is compiled
+    static void enable_pass_timing();
+
+    //Sets the CPU every module is compiled for, native becomes the host's CPU and features, must be called before any module is compiled
+    //Returns false after printing an error if the native target doesn't know the CPU or one of the features
+    static bool set_cpu_target(const CpuTarget& target);
+
+    //Points a JIT's target at the CPU set above
+    static void apply_cpu_target(llvm::orc::JITTargetMachineBuilder& machine_builder);
+    llvm::Type* getType(TypeId type);
+
+    //Runs LLVM's verifier, returns false after printing what is wrong with the generated IR
+    bool verify();
 
     void print_code();
+
+    //Adds the instruction count of every defined function to stats
+    void count_instructions(CompileStats* stats);
     void write_to_file(const string& file_name);
 
-    void compile(const string& file_name);
+    //Runs the standard pass pipeline for optimization_level and writes an object file
+    //With more than one codegen thread the optimized module is split and each partition is emitted on its own thread
+    //Returns false after printing why the object could not be written
+    bool compile(const string& file_name, OptimizationLevel optimization_level = OptimizationLevel::O0, size_t codegen_threads = 1);
+
+    //Optimizes the module and compiles it in memory with ORC's LLJIT, returns its i32 main() or nullptr on failure
+    //The module moves into the JIT, so it cannot be printed or compiled afterwards and main only lives as long as this llvmModule
+    //Externs are looked up in the option's libraries first and then in the ToyC process, which carries the print runtime
+    MainFunction jit_compile(OptimizationLevel optimization_level, const JitOptions& options);
+
+    //Target triple, CPU, features and optimization level, everything the object cache must know about how functions are compiled
+    static string get_target(OptimizationLevel optimization_level);
+
+    //Compiles every function of module on its own and merges them into one object, reusing the objects cache has for unchanged functions
+    //Functions are optimized alone, so nothing is inlined across them, thread_pool may be null to compile on the calling thread
+    static bool compile_functions(const string& file_name, Module* module, OptimizationLevel optimization_level, ObjectCache* cache, ThreadPool* thread_pool, TimeReport* time_report);
+
+    //Where a module holding a single function finds the functions and externs it calls
+    struct FunctionDeclaration
+    {
+        Function* function = nullptr;
+        ExternFunction* extern_function = nullptr;
+    };
+    typedef unordered_map<StringId, FunctionDeclaration> FunctionDeclarations;
+    static FunctionDeclarations get_declarations(Module* module);
+
+    //Generates function alone into a module and context of its own and compiles it into memory, so any thread may call it
+    //Returns an empty string on failure, callees gets every function of module it calls when given
+    static string compile_function(const string& module_name, Module* module, Function& function, const FunctionDeclarations& declarations,
+                                   OptimizationLevel optimization_level, SourceFile* debug_source = nullptr, vector<StringId>* callees = nullptr);
+
+    void generate_struct(Struct& struct_object);
+    llvm::Function* generate_extern_function(ExternFunction& function);
+    llvm::Function* generate_function_prototype(Function& function_node);
+    void generate_function_body(llvm::Function* function, Function& function_node);
 
 protected:
+
     string module_name;
+    Module* ast = nullptr;
+    TimeReport* time_report = nullptr;
+    CompileStats* stats = nullptr;
     unique_ptr<llvm::LLVMContext> context;
     unique_ptr<llvm::Module> module;
-    unordered_map<shared_ptr<Type>, llvm::Type*> type_map;
-
-    void generate_struct(unique_ptr<Struct> &struct_object);
-    llvm::Function* generate_extern_function(unique_ptr<ExternFunction> &function);
-    llvm::Function* generate_function_prototype(unique_ptr<Function>& function_node);
-    void generate_function_body(llvm::Function* function, unique_ptr<Function>& function_node);
-    BlockResult generate_block(llvm::IRBuilder<>* builder, ScopeBlock* parent_scope, unique_ptr<Block>& block);
-    llvm::Value* generate_expression(llvm::IRBuilder<>* builder, ScopeBlock* current_scope, unique_ptr<Expression>& expression);
+    vector<llvm::Type*> type_map = vector<llvm::Type*>(TypeTable::count);
+    const FunctionDeclarations* declarations = nullptr;
+    unique_ptr<llvm::orc::LLJIT> jit;
+
+    SourceFile* debug_source = nullptr;
+    unique_ptr<llvm::DIBuilder> debug_builder;
+    llvm::DIFile* debug_file = nullptr;
+
+    //Debug info must be finished once before the module is printed or compiled, functions cannot get any after that
+    void finish_debug_info();
+
+    llvm::Function* get_function(StringId name);
+
+    //Optimizes and emits the module into memory, returns an empty string if the target cannot emit it
+    string compile_to_memory(OptimizationLevel optimization_level);
+
+    //Emits codegen_threads partitions in parallel and merges their objects with ld -r, returns false after printing why it failed
+    bool emit_partitions(const string& file_name, OptimizationLevel optimization_level, size_t codegen_threads);
+
+    //Every local is an alloca at the top of the entry block wherever it is declared, so mem2reg/SROA can promote all of them
+    llvm::AllocaInst* create_local(llvm::IRBuilder<>* builder, llvm::Type* type, StringId name);
+    llvm::AllocaInst* last_alloca = nullptr;
+
+    //Size of a local for its lifetime markers
+    llvm::ConstantInt* get_local_size(llvm::IRBuilder<>* builder, llvm::AllocaInst* local);
+
+    //Where break and continue go in a loop being generated, branches back to header carry the loop's hints
+    struct LoopTarget
+    {
+        llvm::BasicBlock* header;
+        llvm::BasicBlock* continue_block;
+        llvm::BasicBlock* break_block;
+        size_t live_local_count;
+        bool has_break;
+        llvm::MDNode* loop_id;
+    };
+    vector<LoopTarget> loops;
+
+    //Locals of every block being generated, innermost last, their lifetime ends with their block or a jump out of it
+    vector<llvm::AllocaInst*> live_locals;
+
+    BlockResult generate_block(llvm::IRBuilder<>* builder, VariableTable* variables, BlockId block);
+    BlockResult generate_statement(llvm::IRBuilder<>* builder, VariableTable* variables, StatementRef statement);
+    BlockResult generate_loop(llvm::IRBuilder<>* builder, VariableTable* variables, WhileLoopStatement& loop_node);
+    void create_loop_branch(llvm::IRBuilder<>* builder, llvm::BasicBlock* target);
+    llvm::Value* generate_expression(llvm::IRBuilder<>* builder, VariableTable* variables, ExpressionRef expression);
+    llvm::Value* generate_condition(llvm::IRBuilder<>* builder, VariableTable* variables, ExpressionRef condition);
 };
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "llvm/llvm_jit.hpp"
+
+#include <unistd.h>
+
+#include <llvm/DebugInfo/DWARF/DWARFContext.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/Object/SymbolSize.h>
+#include <llvm/Support/raw_ostream.h>
+
+PerfMapListener* PerfMapListener::get()
+{
+    static PerfMapListener listener;
+    return &listener;
+}
+
+PerfMapListener::PerfMapListener()
+{
+    string path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+    this->file = fopen(path.c_str(), "a");
+    if(this->file == nullptr)
+    {
+        fprintf(stderr, "Error: cannot open %s\n", path.c_str());
+    }
+}
+
+void PerfMapListener::notifyObjectLoaded(ObjectKey, const llvm::object::ObjectFile& object, const llvm::RuntimeDyld::LoadedObjectInfo& info)
+{
+    if(this->file == nullptr)
+    {
+        return;
+    }
+
+    //The debug copy has every section moved to where it was loaded, so its symbol addresses are the real ones
+    llvm::object::OwningBinary<llvm::object::ObjectFile> debug_object = info.getObjectForDebug(object);
+    if(debug_object.getBinary() == nullptr)
+    {
+        return;
+    }
+    const llvm::object::ObjectFile& loaded = *debug_object.getBinary();
+    unique_ptr<llvm::DWARFContext> dwarf = llvm::DWARFContext::create(loaded);
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    for(const std::pair<llvm::object::SymbolRef, uint64_t>& symbol_size: llvm::object::computeSymbolSizes(loaded))
+    {
+        const llvm::object::SymbolRef& symbol = symbol_size.first;
+        llvm::Expected<llvm::object::SymbolRef::Type> type = symbol.getType();
+        llvm::Expected<llvm::StringRef> name = symbol.getName();
+        llvm::Expected<uint64_t> address = symbol.getAddress();
+        if(!type || !name || !address || *type != llvm::object::SymbolRef::ST_Function)
+        {
+            llvm::consumeError(type.takeError());
+            llvm::consumeError(name.takeError());
+            llvm::consumeError(address.takeError());
+            continue;
+        }
+
+        fprintf(this->file, "%llx %llx %.*s", (unsigned long long)*address, (unsigned long long)symbol_size.second, (int)name->size(), name->data());
+        uint64_t section_index = llvm::object::SectionedAddress::UndefSection;
+        llvm::Expected<llvm::object::section_iterator> section = symbol.getSection();
+        if(section && *section != loaded.section_end())
+        {
+            section_index = (*section)->getIndex();
+        }
+        llvm::consumeError(section.takeError());
+
+        llvm::DILineInfo line = dwarf->getLineInfoForAddress({*address, section_index});
+        if(line.Line != 0)
+        {
+            fprintf(this->file, " (%s:%u)", line.FileName.c_str(), line.Line);
+        }
+        fprintf(this->file, "\n");
+    }
+
+    //perf reads the map after the program is gone, possibly after a crash
+    fflush(this->file);
+}
+
+unique_ptr<llvm::orc::LLJIT> create_jit(llvm::orc::JITTargetMachineBuilder machine_builder, const JitOptions& options)
+{
+    llvm::orc::LLJITBuilder builder;
+    builder.setJITTargetMachineBuilder(std::move(machine_builder));
+    if(options.perf_map || options.jitdump)
+    {
+        //Listeners only attach to RuntimeDyld, which is what LLJIT picks on ELF anyway
+        builder.setObjectLinkingLayerCreator([&options](llvm::orc::ExecutionSession& session, const llvm::Triple&) -> llvm::Expected<unique_ptr<llvm::orc::ObjectLayer>>
+        {
+            auto layer = std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(session, []() { return std::make_unique<llvm::SectionMemoryManager>(); });
+            if(options.perf_map)
+            {
+                layer->registerJITEventListener(*PerfMapListener::get());
+            }
+            if(options.jitdump)
+            {
+                llvm::JITEventListener* jitdump = llvm::JITEventListener::createPerfJITEventListener();
+                if(jitdump == nullptr)
+                {
+                    return llvm::make_error<llvm::StringError>("this LLVM was built without perf support", llvm::inconvertibleErrorCode());
+                }
+                layer->registerJITEventListener(*jitdump);
+            }
+            return layer;
+        });
+    }
+
+    llvm::Expected<unique_ptr<llvm::orc::LLJIT>> jit = builder.create();
+    if(!jit)
+    {
+        llvm::errs() << "Could not create the JIT: " << llvm::toString(jit.takeError()) << "\n";
+        return nullptr;
+    }
+
+    //Generators are searched in the order they are added, so a library can replace the built in runtime
+    llvm::orc::JITDylib& dylib = (*jit)->getMainJITDylib();
+    char global_prefix = (*jit)->getDataLayout().getGlobalPrefix();
+    for(const string& library: options.libraries)
+    {
+        auto generator = llvm::orc::DynamicLibrarySearchGenerator::Load(library.c_str(), global_prefix);
+        if(!generator)
+        {
+            llvm::errs() << "Could not load " << library << ": " << llvm::toString(generator.takeError()) << "\n";
+            return nullptr;
+        }
+        dylib.addGenerator(std::move(*generator));
+    }
+    auto process_generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(global_prefix);
+    if(!process_generator)
+    {
+        llvm::errs() << "Could not search the ToyC process: " << llvm::toString(process_generator.takeError()) << "\n";
+        return nullptr;
+    }
+    dylib.addGenerator(std::move(*process_generator));
+    return std::move(*jit);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "containers.hpp"
+
+#include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+
+#include <mutex>
+#include <stdio.h>
+
+//How programs run in process are linked and what profilers are told about them
+struct JitOptions
+{
+    //Searched for externs before the ToyC process
+    vector<string> libraries;
+
+    //Lists every compiled function in /tmp/perf-<pid>.map so perf report can name JIT code
+    bool perf_map = false;
+
+    //Also writes a jitdump file with code and line tables for perf inject --jit, through LLVM's PerfJITEventListener
+    bool jitdump = false;
+};
+
+//Appends "<start> <size> <name> (<file>:<line>)" to /tmp/perf-<pid>.map for every function the JIT loads
+//The line comes from the object's line table, so it is only there for modules built with debug info
+class PerfMapListener : public llvm::JITEventListener
+{
+public:
+    //The map is per process, so is the listener
+    static PerfMapListener* get();
+
+    void notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile& object, const llvm::RuntimeDyld::LoadedObjectInfo& info) override;
+
+protected:
+    PerfMapListener();
+
+    std::mutex lock;
+    FILE* file = nullptr;
+};
+
+//An LLJIT for machine_builder that reports to the profilers in options and resolves externs from its libraries and then the ToyC process
+//Returns nullptr after printing why it could not be created
+unique_ptr<llvm::orc::LLJIT> create_jit(llvm::orc::JITTargetMachineBuilder machine_builder, const JitOptions& options);
@@ -0,0 +1,267 @@
+#include "llvm/llvm_lazy_jit.hpp"
+#include "llvm/llvm_jit.hpp"
+
+#include <stdio.h>
+
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LazyReexports.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+//Called by a stub whose function failed to compile, the reason was already printed
+static void lazy_compile_failed()
+{
+    fflush(stdout);
+    fprintf(stderr, "Error: a function called by the program failed to compile\n");
+    exit(-1);
+}
+
+//Holds one function's body in the implementation dylib until something looks it up
+class llvmLazyJit::FunctionUnit : public llvm::orc::MaterializationUnit
+{
+public:
+    FunctionUnit(llvmLazyJit* lazy_jit, size_t index, llvm::orc::SymbolStringPtr symbol)
+    :MaterializationUnit(Interface(llvm::orc::SymbolFlagsMap{{symbol, llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable}}, nullptr)),
+    lazy_jit(lazy_jit), index(index)
+    {
+    };
+
+    llvm::StringRef getName() const override
+    {
+        return "ToyC function";
+    };
+
+    void materialize(std::unique_ptr<llvm::orc::MaterializationResponsibility> responsibility) override
+    {
+        vector<StringId> callees;
+        string object = this->lazy_jit->compile(this->index, &callees);
+        if(object.empty())
+        {
+            responsibility->failMaterialization();
+            return;
+        }
+
+        this->lazy_jit->speculate(callees);
+        this->lazy_jit->jit->getObjLinkingLayer().emit(std::move(responsibility), llvm::MemoryBuffer::getMemBufferCopy(object, this->getName()));
+    };
+
+protected:
+    llvmLazyJit* lazy_jit;
+    size_t index;
+
+    //Each unit defines exactly one symbol, so there is never a part of it left to drop
+    void discard(const llvm::orc::JITDylib&, const llvm::orc::SymbolStringPtr&) override
+    {
+    };
+};
+
+llvmLazyJit::llvmLazyJit(const string& module_name, Module* module, OptimizationLevel optimization_level, ThreadPool* thread_pool, TimeReport* time_report,
+                         SourceFile* debug_source)
+:module_name(module_name), module(module), optimization_level(optimization_level), thread_pool(thread_pool), time_report(time_report), debug_source(debug_source)
+{
+    if(debug_source != nullptr)
+    {
+        //Builds the line table now, functions compiling on other threads only read it
+        debug_source->get_location((uint32_t)0);
+    }
+}
+
+llvmLazyJit::~llvmLazyJit()
+{
+    //Queued speculation returns at once, compiles already running must finish before the JIT goes away
+    this->stopping = true;
+    if(this->thread_pool != nullptr)
+    {
+        this->thread_pool->wait();
+    }
+}
+
+bool llvmLazyJit::initialize(const JitOptions& options)
+{
+    {
+        TimeReport::Timer timer(this->time_report, "signatures");
+        try
+        {
+            this->resolver.begin(this->module);
+            for(Struct& struct_object: this->module->structs)
+            {
+                this->resolver.resolve_struct(struct_object);
+            }
+            for(ExternFunction& function: this->module->extern_functions)
+            {
+                this->resolver.resolve_extern(function);
+            }
+            for(Function& function: this->module->functions)
+            {
+                this->resolver.resolve_function(function);
+            }
+        }
+        catch(const ResolveError& error)
+        {
+            printf("%s", error.message.c_str());
+            return false;
+        }
+    }
+
+    this->declarations = llvmModule::get_declarations(this->module);
+    size_t function_count = this->module->functions.size();
+    this->started = std::make_unique<std::atomic<bool>[]>(function_count);
+    for(size_t i = 0; i < function_count; i++)
+    {
+        this->started[i] = false;
+        this->function_indices[this->module->functions[i].name] = i;
+    }
+
+    TimeReport::Timer timer(this->time_report, "jit");
+    llvm::Expected<llvm::orc::JITTargetMachineBuilder> machine_builder = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if(!machine_builder)
+    {
+        llvm::errs() << "Could not detect the host: " << llvm::toString(machine_builder.takeError()) << "\n";
+        return false;
+    }
+    llvmModule::apply_cpu_target(*machine_builder);
+    this->jit = create_jit(std::move(*machine_builder), options);
+    if(!this->jit)
+    {
+        return false;
+    }
+    llvm::orc::ExecutionSession& session = this->jit->getExecutionSession();
+    const llvm::Triple& triple = this->jit->getTargetTriple();
+
+    //compile() prints why a function failed, and the stub's error handler stops the program
+    session.setErrorReporter([](llvm::Error error) { llvm::consumeError(std::move(error)); });
+
+    auto call_through_manager = llvm::orc::createLocalLazyCallThroughManager(triple, session, llvm::pointerToJITTargetAddress(&lazy_compile_failed));
+    if(!call_through_manager)
+    {
+        llvm::errs() << "Could not create lazy call through: " << llvm::toString(call_through_manager.takeError()) << "\n";
+        return false;
+    }
+    this->call_through_manager = std::move(*call_through_manager);
+    this->stubs_manager = llvm::orc::createLocalIndirectStubsManagerBuilder(triple)();
+
+    llvm::orc::JITDylib& stubs = this->jit->getMainJITDylib();
+
+    //Bodies link only against the stubs, linking one never pulls in the bodies of the functions it calls
+    llvm::Expected<llvm::orc::JITDylib&> bodies = this->jit->createJITDylib(this->module_name + ".bodies");
+    if(!bodies)
+    {
+        llvm::errs() << "Could not create the JIT's dylib: " << llvm::toString(bodies.takeError()) << "\n";
+        return false;
+    }
+    this->bodies = &*bodies;
+    this->bodies->setLinkOrder({{&stubs, llvm::orc::JITDylibLookupFlags::MatchExportedSymbolsOnly}}, false);
+
+    llvm::orc::SymbolAliasMap aliases;
+    for(size_t i = 0; i < function_count; i++)
+    {
+        llvm::orc::SymbolStringPtr symbol = this->jit->mangleAndIntern(llvm::StringRef(StringCache::get(this->module->functions[i].name)));
+        llvm::Error error = this->bodies->define(std::make_unique<FunctionUnit>(this, i, symbol));
+        if(error)
+        {
+            llvm::errs() << "Could not add a function to the JIT: " << llvm::toString(std::move(error)) << "\n";
+            return false;
+        }
+        aliases[symbol] = llvm::orc::SymbolAliasMapEntry(symbol, llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+    }
+
+    llvm::Error error = stubs.define(llvm::orc::lazyReexports(*this->call_through_manager, *this->stubs_manager, *this->bodies, std::move(aliases)));
+    if(error)
+    {
+        llvm::errs() << "Could not add the stubs to the JIT: " << llvm::toString(std::move(error)) << "\n";
+        return false;
+    }
+    return true;
+}
+
+llvmModule::MainFunction llvmLazyJit::get_main()
+{
+    auto main_index = this->function_indices.find(StringCache::add("main"));
+    if(main_index == this->function_indices.end())
+    {
+        llvm::errs() << "Error: running a program needs a function i32 main()\n";
+        return nullptr;
+    }
+
+    Function& main_function = this->module->functions[main_index->second];
+    if(main_function.return_type != TypeTable::get_id(TypeEnum::Int32) || main_function.parameters.count != 0)
+    {
+        llvm::errs() << "Error: running a program needs a function i32 main()\n";
+        return nullptr;
+    }
+
+    //Only builds main's stub, main itself compiles on the call
+    llvm::Expected<llvm::JITEvaluatedSymbol> main_symbol = this->jit->lookup("main");
+    if(!main_symbol)
+    {
+        llvm::errs() << "Could not find main: " << llvm::toString(main_symbol.takeError()) << "\n";
+        return nullptr;
+    }
+    return (llvmModule::MainFunction)main_symbol->getAddress();
+}
+
+string llvmLazyJit::compile(size_t index, vector<StringId>* callees)
+{
+    this->started[index] = true;
+    Function& function = this->module->functions[index];
+    try
+    {
+        this->resolver.resolve_function_body(function);
+    }
+    catch(const ResolveError& error)
+    {
+        printf("%s", error.message.c_str());
+        return string();
+    }
+
+    string object = llvmModule::compile_function(this->module_name, this->module, function, this->declarations, this->optimization_level, this->debug_source, callees);
+    this->compiled_count++;
+    return object;
+}
+
+void llvmLazyJit::speculate(const vector<StringId>& callees)
+{
+    if(this->thread_pool == nullptr)
+    {
+        return;
+    }
+
+    for(StringId callee: callees)
+    {
+        //Externs have no body to compile, and speculate runs on workers so the map is only ever read
+        auto callee_index = this->function_indices.find(callee);
+        if(callee_index == this->function_indices.end())
+        {
+            continue;
+        }
+
+        size_t index = callee_index->second;
+        if(this->started[index])
+        {
+            continue;
+        }
+
+        //Looking the body up compiles it, a call that arrives meanwhile waits for this compile instead of starting its own
+        this->thread_pool->add_job([this, index]()
+        {
+            if(this->stopping || this->started[index])
+            {
+                return;
+            }
+
+            double wall_start = TimeReport::get_wall_time();
+            double cpu_start = TimeReport::get_cpu_time();
+            llvm::orc::SymbolStringPtr symbol = this->jit->mangleAndIntern(llvm::StringRef(StringCache::get(this->module->functions[index].name)));
+            llvm::Expected<llvm::JITEvaluatedSymbol> body = this->jit->getExecutionSession().lookup({this->bodies}, symbol);
+            if(!body)
+            {
+                //The compile already printed why, the program only fails if it really calls the function
+                llvm::consumeError(body.takeError());
+            }
+            if(this->time_report != nullptr)
+            {
+                this->time_report->add("worker threads", TimeReport::get_wall_time() - wall_start, TimeReport::get_cpu_time() - cpu_start);
+            }
+        });
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "containers.hpp"
+#include "ast/module.hpp"
+#include "ast/ast_resolver.hpp"
+#include "thread_pool.hpp"
+#include "time_report.hpp"
+#include "llvm/llvm_code_gen.hpp"
+
+#include <atomic>
+
+namespace llvm::orc
+{
+    class JITDylib;
+    class LazyCallThroughManager;
+    class IndirectStubsManager;
+}
+
+//Runs a program compiling each function on its first call, until then its body stays unresolved AST
+//Every call goes through an ORC lazy reexport, a stub that compiles the function the first time and afterwards jumps straight to it
+//With a thread pool the functions a newly compiled function calls are compiled speculatively in the background
+class llvmLazyJit
+{
+public:
+    //With a debug_source every function gets debug info pointing at the line it starts on in that file
+    llvmLazyJit(const string& module_name, Module* module, OptimizationLevel optimization_level, ThreadPool* thread_pool = nullptr, TimeReport* time_report = nullptr,
+                SourceFile* debug_source = nullptr);
+
+    //Waits for speculative compiles that already started
+    ~llvmLazyJit();
+
+    //Resolves structs and signatures and puts a stub in front of every function, errors in bodies only show up once they are compiled
+    //Externs are looked up in the option's libraries first and then in the ToyC process
+    bool initialize(const JitOptions& options);
+
+    //The stub of i32 main(), nullptr if there is none
+    llvmModule::MainFunction get_main();
+
+    size_t get_compiled_count() { return this->compiled_count; };
+    size_t get_function_count() { return this->module->functions.size(); };
+
+protected:
+    class FunctionUnit;
+
+    string module_name;
+    Module* module;
+    OptimizationLevel optimization_level;
+    ThreadPool* thread_pool;
+    TimeReport* time_report;
+    SourceFile* debug_source;
+
+    AstResolver resolver;
+    llvmModule::FunctionDeclarations declarations;
+    unordered_map<StringId, size_t> function_indices;
+
+    //Set once a function starts compiling, so speculation skips it
+    unique_ptr<std::atomic<bool>[]> started;
+    std::atomic<size_t> compiled_count{0};
+    std::atomic<bool> stopping{false};
+
+    unique_ptr<llvm::orc::LLJIT> jit;
+    unique_ptr<llvm::orc::LazyCallThroughManager> call_through_manager;
+    unique_ptr<llvm::orc::IndirectStubsManager> stubs_manager;
+    llvm::orc::JITDylib* bodies = nullptr;
+
+    //Resolves, generates and compiles one function body, returns an empty string after printing why it failed
+    string compile(size_t index, vector<StringId>* callees);
+    void speculate(const vector<StringId>& callees);
+};
@@ -1,34 +0,0 @@
-#include "scope_block.hpp"
-
-ScopeBlock::ScopeBlock(ScopeBlock* parent)
-{
-    this->parent = parent;
-};
-
-void ScopeBlock::addLocalVariable(const string& name, llvm::AllocaInst* variable)
-{
-    if(this->variables.find(name) != this->variables.end())
-    {
-        printf("Error: Local variable %s redefined\n", name.c_str());
-    }
-
-    this->variables[name] = variable;
-};
-
-llvm::AllocaInst* ScopeBlock::getLocalVariable(const string& name)
-{
-    auto find_it = this->variables.find(name);
-    if(find_it != this->variables.end())
-    {
-        return find_it->second;
-    }
-    else
-    {
-        if(this->parent != nullptr)
-        {
-            return this->parent->getLocalVariable(name);
-        }
-    }
-    
-    return nullptr;
-};
\ No newline at end of file
@@ -0,0 +1,331 @@
+#include "object_cache.hpp"
+
+#include <cstring>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <thread>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/SHA1.h>
+
+//Part of every key, bump it whenever codegen changes what it emits for the same AST
+static const char* const cache_version = "toyc-object-cache-4";
+
+//Feeds a function's AST into a SHA1, names go in as text since StringIds differ between runs
+class KeyBuilder
+{
+public:
+    KeyBuilder(Module* module, const unordered_map<StringId, string>& signatures)
+    :module(module), signatures(signatures)
+    {
+    };
+
+    void add(llvm::StringRef text)
+    {
+        //Length first so neighbouring strings cannot run into each other
+        this->add((uint64_t)text.size());
+        this->hasher.update(text);
+    };
+
+    void add(uint64_t value)
+    {
+        uint8_t bytes[sizeof(value)];
+        memcpy(bytes, &value, sizeof(value));
+        this->hasher.update(llvm::ArrayRef<uint8_t>(bytes, sizeof(bytes)));
+    };
+
+    void add_name(StringId name)
+    {
+        string_view text = StringCache::get(name);
+        this->add(llvm::StringRef(text.data(), text.size()));
+    };
+
+    void add_type(TypeId type)
+    {
+        //Struct ids depend on the order structs were first seen in, so a struct is hashed by its fields instead
+        this->add(TypeTable::get(type).name);
+        if(TypeTable::get_class(type) == TypeClass::Struct)
+        {
+            for(TypeId field: TypeTable::get_fields(type))
+            {
+                this->add_type(field);
+            }
+        }
+        else
+        {
+            this->add(type);
+        }
+    };
+
+    void add_call(StringId name, FunctionArguments arguments)
+    {
+        //The callee's signature is all the call depends on, its body may change freely
+        this->add_name(name);
+        auto signature = this->signatures.find(name);
+        this->add(signature != this->signatures.end() ? llvm::StringRef(signature->second) : llvm::StringRef());
+        for(ExpressionRef argument: this->module->get_list(arguments))
+        {
+            this->add_expression(argument);
+        }
+    };
+
+    void add_block(BlockId block)
+    {
+        if(block == InvalidBlock)
+        {
+            this->add((uint64_t)InvalidBlock);
+            return;
+        }
+
+        NodeSpan<StatementRef> statements = this->module->get_block(block);
+        this->add((uint64_t)statements.size());
+        for(StatementRef statement: statements)
+        {
+            this->add_statement(statement);
+        }
+    };
+
+    void add_statement(StatementRef statement)
+    {
+        if(!statement.is_valid())
+        {
+            this->add((uint64_t)StatementRef::invalid_value);
+            return;
+        }
+
+        this->add((uint64_t)statement.get_type());
+        switch (statement.get_type())
+        {
+            case StatementType::Declaration:
+            {
+                DeclarationStatement& declaration = this->module->get<DeclarationStatement>(statement);
+                this->add_type(declaration.variable_type);
+                this->add_name(declaration.name);
+                this->add_expression(declaration.expression);
+            }
+                break;
+            case StatementType::Assignment:
+            {
+                AssignmentStatement& assignment = this->module->get<AssignmentStatement>(statement);
+                this->add_name(assignment.name);
+                this->add_expression(assignment.expression);
+            }
+                break;
+            case StatementType::Block:
+                this->add_block(this->module->get<BlockStatement>(statement).block);
+                break;
+            case StatementType::FunctionCall:
+            {
+                FunctionCallStatement& function_call = this->module->get<FunctionCallStatement>(statement);
+                this->add_call(function_call.function_name, function_call.arguments);
+            }
+                break;
+            case StatementType::If:
+            {
+                IfStatement& if_statement = this->module->get<IfStatement>(statement);
+                this->add_expression(if_statement.condition);
+                this->add_block(if_statement.if_block);
+                this->add_block(if_statement.else_block);
+            }
+                break;
+            case StatementType::While:
+            {
+                WhileLoopStatement& while_statement = this->module->get<WhileLoopStatement>(statement);
+                this->add_statement(while_statement.init);
+                this->add_expression(while_statement.condition);
+                this->add_statement(while_statement.step);
+                this->add((uint64_t)while_statement.test_first);
+                this->add(while_statement.hints.unroll);
+                this->add(while_statement.hints.vectorize);
+                this->add_block(while_statement.loop_block);
+            }
+                break;
+            case StatementType::Jump:
+                this->add((uint64_t)this->module->get<JumpStatement>(statement).jump);
+                break;
+            case StatementType::Return:
+                this->add_expression(this->module->get<ReturnStatement>(statement).return_expression);
+                break;
+        }
+    };
+
+    void add_expression(ExpressionRef expression)
+    {
+        if(!expression.is_valid())
+        {
+            this->add((uint64_t)ExpressionRef::invalid_value);
+            return;
+        }
+
+        this->add((uint64_t)expression.get_type());
+        this->add_type(this->module->get_resolved_type(expression));
+        switch (expression.get_type())
+        {
+            case ExpressionType::ConstInt:
+                this->add(this->module->get<ConstantIntegerExpression>(expression).value);
+                break;
+            case ExpressionType::ConstFloat:
+            {
+                double value = this->module->get<ConstantDoubleExpression>(expression).value;
+                uint64_t bits;
+                memcpy(&bits, &value, sizeof(bits));
+                this->add(bits);
+            }
+                break;
+            case ExpressionType::Identifier:
+                this->add_name(this->module->get<IdentifierExpression>(expression).identifier_name);
+                break;
+            case ExpressionType::Function:
+            {
+                FunctionCallExpression& function_call = this->module->get<FunctionCallExpression>(expression);
+                this->add_call(function_call.function_name, function_call.arguments);
+            }
+                break;
+            case ExpressionType::BinaryOperator:
+            {
+                BinaryOperatorExpression& binary_operator = this->module->get<BinaryOperatorExpression>(expression);
+                this->add((uint64_t)binary_operator.binary_op);
+                this->add_expression(binary_operator.lhs);
+                this->add_expression(binary_operator.rhs);
+            }
+                break;
+            default:
+                break;
+        }
+    };
+
+    string get_key()
+    {
+        return llvm::toHex(this->hasher.final(), true);
+    };
+
+protected:
+    Module* module;
+    const unordered_map<StringId, string>& signatures;
+    llvm::SHA1 hasher;
+};
+
+static string get_signature(Module* module, TypeId return_type, FunctionParameters parameters)
+{
+    string signature = TypeTable::get(return_type).name;
+    signature += '(';
+    for(FunctionParameter& parameter: module->get_list(parameters))
+    {
+        signature += TypeTable::get(parameter.type).name;
+        signature += ',';
+    }
+    signature += ')';
+    return signature;
+}
+
+ObjectCache::ObjectCache(const string& directory)
+:directory(directory)
+{
+    if(!this->directory.empty())
+    {
+        mkdir(this->directory.c_str(), 0755);
+    }
+}
+
+vector<string> ObjectCache::get_function_keys(Module* module, const string& target)
+{
+    unordered_map<StringId, string> signatures;
+    for(ExternFunction& function: module->extern_functions)
+    {
+        signatures[function.name] = get_signature(module, function.return_type, function.parameters);
+    }
+    for(Function& function: module->functions)
+    {
+        signatures[function.name] = get_signature(module, function.return_type, function.parameters);
+    }
+
+    vector<string> keys;
+    keys.reserve(module->functions.size());
+    for(Function& function: module->functions)
+    {
+        KeyBuilder builder(module, signatures);
+        builder.add(cache_version);
+        builder.add(target);
+        builder.add_name(function.name);
+        builder.add(signatures[function.name]);
+        for(FunctionParameter& parameter: module->get_list(function.parameters))
+        {
+            builder.add_name(parameter.name);
+        }
+        for(StringId target: module->get_list(function.target_clones))
+        {
+            builder.add_name(target);
+        }
+        builder.add_block(function.block);
+        keys.push_back(builder.get_key());
+    }
+    return keys;
+}
+
+const string* ObjectCache::find(const string& key)
+{
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        auto iterator = this->objects.find(key);
+        if(iterator != this->objects.end())
+        {
+            this->hits++;
+            return &iterator->second;
+        }
+    }
+
+    if(!this->directory.empty())
+    {
+        FILE* file = fopen(this->get_path(key).c_str(), "rb");
+        if(file)
+        {
+            string object;
+            char buffer[16384];
+            size_t read;
+            while((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            {
+                object.append(buffer, read);
+            }
+            fclose(file);
+
+            this->hits++;
+            std::lock_guard<std::mutex> guard(this->lock);
+            return &this->objects.emplace(key, std::move(object)).first->second;
+        }
+    }
+
+    this->misses++;
+    return nullptr;
+}
+
+const string* ObjectCache::store(const string& key, string object)
+{
+    if(!this->directory.empty())
+    {
+        //Written under a temporary name and renamed, so a run that is killed never leaves half an object behind a key
+        string path = this->get_path(key);
+        string temporary_path = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        FILE* file = fopen(temporary_path.c_str(), "wb");
+        if(file)
+        {
+            bool written = fwrite(object.data(), 1, object.size(), file) == object.size();
+            written = fclose(file) == 0 && written;
+            if(!written || rename(temporary_path.c_str(), path.c_str()) != 0)
+            {
+                remove(temporary_path.c_str());
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    return &this->objects.emplace(key, std::move(object)).first->second;
+}
+
+string ObjectCache::get_path(const string& key)
+{
+    if(this->directory.empty())
+    {
+        return string();
+    }
+    return this->directory + "/" + key + ".o";
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "containers.hpp"
+#include "ast/module.hpp"
+
+#include <atomic>
+#include <mutex>
+
+//Compiled objects of single functions, keyed by a hash of everything their machine code depends on
+//Always kept in memory so --watch reuses them between rebuilds, and also on disk when given a directory so later runs can
+//A key never changes meaning, so entries are never invalidated, only orphaned
+class ObjectCache
+{
+public:
+    //An empty directory keeps the cache in memory only
+    ObjectCache(const string& directory);
+
+    //One key per function of module, in order, built from its resolved AST and the signatures of everything it calls
+    //target must describe the target and every option that changes the machine code
+    static vector<string> get_function_keys(Module* module, const string& target);
+
+    //Returns nullptr on a miss, the object stays valid as long as the cache
+    const string* find(const string& key);
+    const string* store(const string& key, string object);
+
+    //Path of the on disk copy, empty for a memory only cache
+    string get_path(const string& key);
+
+    size_t get_hits() { return this->hits; };
+    size_t get_misses() { return this->misses; };
+
+protected:
+    string directory;
+    std::mutex lock;
+    unordered_map<string, string> objects;
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+};
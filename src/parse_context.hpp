@@ -0,0 +1,60 @@
+#pragma once
+
+#include "containers.hpp"
+#include "source_manager.hpp"
+#include "ast/module.hpp"
+
+#include <functional>
+
+//Lists the grammar is still appending to, they live in the module arena until they are copied into the module's flat list arrays
+template<typename T>
+using ParseList = std::pmr::vector<T>;
+
+//Called after every struct, extern and function, no parser list is alive at that point so the module arena may be released
+typedef std::function<void(Module* module)> TopLevelCallback;
+
+//Everything one run of the parser writes to, so several files can be parsed at once
+struct ParseContext
+{
+    SourceFile* file;
+    Module* module;
+    const TopLevelCallback* top_level_parsed = nullptr;
+
+    //Offset of the first token of the top level item being parsed
+    uint32_t item_offset = 0;
+    bool item_started = false;
+
+    //Set by yyerror, the parse ends at the next token and no more top level items are reported
+    bool failed = false;
+
+    //Set by @target_clones for the function that follows it
+    NodeList<StringId> target_clones;
+
+    NodeList<StringId> take_target_clones()
+    {
+        NodeList<StringId> target_clones = this->target_clones;
+        this->target_clones = NodeList<StringId>();
+        return target_clones;
+    };
+
+    void finish_top_level()
+    {
+        this->item_started = false;
+        if(!this->failed && this->top_level_parsed != nullptr && *this->top_level_parsed)
+        {
+            (*this->top_level_parsed)(this->module);
+        }
+    };
+
+    template<typename T>
+    ParseList<T>* create_list()
+    {
+        return this->module->arena.create<ParseList<T>>(this->module->arena.get_resource());
+    };
+};
+
+//Parses a whole file, returns nullptr if it could not be parsed
+unique_ptr<Module> parse_source_file(SourceFile* file);
+
+//Parses into module, calling top_level_parsed as each top level item is finished, returns false if the file could not be parsed
+bool parse_source_file(SourceFile* file, Module* module, const TopLevelCallback& top_level_parsed);
@@ -1,35 +1,100 @@
 %{
     #include "string_cache.hpp"
+    #include "lexer.hpp"
+    #include "parse_context.hpp"
     #include "ast/module.hpp"
     #include "ast/expression.hpp"
     #include "ast/statement.hpp"
     #include "ast/types.hpp"
 
-    extern int yylex();
-    void yyerror(const char *s) { std::printf("Error: %s\n", s); std::exit(1); }
-
-    unique_ptr<Module> ast_module;
+    //Files are parsed on pool threads, so an error only fails its own file, only the first one is reported
+    void yyerror(void* scanner, ParseContext* context, const char *s)
+    {
+        if(context->failed)
+        {
+            return;
+        }
+        SourceLocation location = lexer_location(scanner);
+        std::printf("%s:%u:%u: Error: %s\n", context->file->get_path().c_str(), location.line, location.column, s);
+        context->failed = true;
+    }
 %}
 
+%code requires {
+    #include "parse_context.hpp"
+}
+
+%code {
+    //Every token the parser reads passes through here so --stats can count them, and top level items know where they start
+    //After an error the input ends early, so the parse stops at the next token
+    static int count_token(YYSTYPE* value, void* scanner, ParseContext* context)
+    {
+        if(context->failed)
+        {
+            return 0;
+        }
+        context->module->token_count++;
+        int token = yylex(value, scanner);
+        if(!context->item_started)
+        {
+            context->item_offset = lexer_offset(scanner);
+            context->item_started = true;
+        }
+        return token;
+    }
+    #define yylex(value, scanner) count_token(value, scanner, context)
+
+    //@unroll(n) and @vectorize(width) in front of a loop, value is LoopHints::any when no count is given
+    static void add_loop_hint(void* scanner, ParseContext* context, StatementRef loop, StringId name, long value)
+    {
+        if(value < 1 || value > 0xFFFFFFFF)
+        {
+            yyerror(scanner, context, "loop hints need a count of at least 1");
+        }
+
+        LoopHints& hints = context->module->get<WhileLoopStatement>(loop).hints;
+        if(StringCache::get(name) == "unroll")
+        {
+            hints.unroll = (uint32_t)value;
+        }
+        else if(StringCache::get(name) == "vectorize")
+        {
+            hints.vectorize = (uint32_t)value;
+        }
+        else
+        {
+            yyerror(scanner, context, "unknown loop attribute");
+        }
+    }
+
+    //Structs and externs have no body to clone, an attribute in front of one is a mistake
+    static void no_attributes(void* scanner, ParseContext* context)
+    {
+        if(context->target_clones.count != 0)
+        {
+            yyerror(scanner, context, "@target_clones only applies to functions");
+        }
+    }
+}
+
+%define api.pure full
+%lex-param {void* scanner}
+%parse-param {void* scanner} {ParseContext* context}
+
 /* Represents the many different ways we can access our data */
 %union {
 	long int_val;
 	double double_val;
-	size_t string_id;
-
-	Module* module_ptr;
+	StringId string_id;
 
-	Struct* struct_ptr;
-	StructMembers* struct_members;
+	ParseList<StructMember>* struct_members;
+	ParseList<FunctionParameter>* function_parameters;
 
-    ExternFunction* extern_function;
-    Function* function_ptr;
-	FunctionParameters* function_parameters;
-
-    Block* block_ptr;
-    Statement* statement_ptr;
-	Expression* expression_ptr;
-    FunctionArguments* function_arguments;
+    ParseList<StatementRef>* block_list;
+    StatementRef statement_ref;
+	ExpressionRef expression_ref;
+    ParseList<ExpressionRef>* function_arguments;
+    ParseList<StringId>* names;
 }
 
 //Keywords
@@ -37,7 +102,7 @@
 %token STRUCT ENUM UNION INTERFACE TEMPLATE
 
 //Symbols
-%token SEMI LPAREN RPAREN LBRACE RBRACE LBRACK RBRACK LARROW RARROW DOT COMMA ASSIGN
+%token SEMI LPAREN RPAREN LBRACE RBRACE LBRACK RBRACK LARROW RARROW DOT COMMA ASSIGN AT
 
 //Binary Ops
 %token ADD SUB MUL DIV MOD
@@ -49,83 +114,161 @@
 %token <double_val> FLOAT
 %token <string_id> IDENTIFIER
 
-%type <module_ptr> module
-
-%type <struct_ptr> struct
 %type <struct_members> members
-
-%type <function_ptr> function
-%type <extern_function> extern
 %type <function_parameters> parameters
 
-%type <block_ptr> block
-%type <statement_ptr> statement
-%type <expression_ptr> expression
+%type <block_list> block
+%type <statement_ref> statement loop for_statement
+%type <expression_ref> expression for_condition
 %type <function_arguments> arguments
+%type <names> names
+%type <string_id> name
 
 //Supposedly enforces operator precedence
 //Need to test
+%left EQUAL NOT_EQUAL
+%left LARROW RARROW LESS_EQUAL GREATER_EQUAL
 %left ADD SUB
 %left MUL DIV MOD
 
 %start file
 
 %%
-file: module { ast_module = unique_ptr<Module>($<module_ptr>1); };
-
-module: struct { Module* module = new Module(); module->structs.push_back(unique_ptr<Struct>($<struct_ptr>1)); $$ = module; }
-    | module struct { $1->structs.push_back(unique_ptr<Struct>($<struct_ptr>2)); }
-    | function { Module* module = new Module(); module->functions.push_back(unique_ptr<Function>($<function_ptr>1)); $$ = module; }
-    | module function { $1->functions.push_back(unique_ptr<Function>($<function_ptr>2)); }
-    | extern { Module* module = new Module(); module->extern_functions.push_back(unique_ptr<ExternFunction>($<extern_function>1)); $$ = module; }
-    | module extern { $1->extern_functions.push_back(unique_ptr<ExternFunction>($<extern_function>2)); }
+file: module { no_attributes(scanner, context); };
+
+module: struct
+    | module struct
+    | function
+    | module function
+    | extern
+    | module extern
+    | attribute
+    | module attribute
     ;
 
-struct: STRUCT IDENTIFIER LBRACE members RBRACE { $$ = new Struct(StringCache::get($<string_id>2), $<struct_members>4); };
+//Attributes belong to the function after them
+attribute: AT IDENTIFIER LPAREN names RPAREN
+        {
+            if(StringCache::get($<string_id>2) != "target_clones") { yyerror(scanner, context, "unknown attribute"); }
+            if(context->target_clones.count != 0) { yyerror(scanner, context, "function already has @target_clones"); }
+            context->target_clones = context->module->add_list(*$<names>4);
+        };
 
-members: IDENTIFIER IDENTIFIER SEMI { StructMembers* members = new StructMembers(); members->push_back(StructMember(false, StringCache::get($<string_id>1), StringCache::get($<string_id>2))); $$ = members; }
-        | members IDENTIFIER IDENTIFIER SEMI { $$->push_back(StructMember(false, StringCache::get($<string_id>2), StringCache::get($<string_id>3))); }
+names: name { ParseList<StringId>* names = context->create_list<StringId>(); names->push_back($<string_id>1); $$ = names; }
+        | names COMMA name { $1->push_back($<string_id>3); }
         ;
 
-function: IDENTIFIER IDENTIFIER LPAREN RPAREN LBRACE block RBRACE { $$ = new Function(StringCache::get($<string_id>1), StringCache::get($<string_id>2), nullptr, $<block_ptr>6); }
-        | IDENTIFIER IDENTIFIER LPAREN parameters RPAREN LBRACE block RBRACE { $$ = new Function(StringCache::get($<string_id>1), StringCache::get($<string_id>2), $<function_parameters>4, $<block_ptr>7); }
+//Feature names like sse4.2 lex as an identifier, a dot and a number
+name: IDENTIFIER
+        | IDENTIFIER DOT INTEGER { $$ = StringCache::add(string(StringCache::get($<string_id>1)) + "." + std::to_string($<int_val>3)); }
         ;
 
-extern: IDENTIFIER IDENTIFIER LPAREN RPAREN SEMI { $$ = new ExternFunction(StringCache::get($<string_id>1), StringCache::get($<string_id>2)); }
-      | IDENTIFIER IDENTIFIER LPAREN parameters RPAREN SEMI { $$ = new ExternFunction(StringCache::get($<string_id>1), StringCache::get($<string_id>2), $<function_parameters>4); }
+struct: STRUCT IDENTIFIER LBRACE members RBRACE { no_attributes(scanner, context); context->module->structs.push_back(Struct($<string_id>2, context->module->add_list(*$<struct_members>4))); context->finish_top_level(); };
+
+members: IDENTIFIER IDENTIFIER SEMI { ParseList<StructMember>* members = context->create_list<StructMember>(); members->push_back(StructMember(false, $<string_id>1, $<string_id>2)); $$ = members; }
+        | members IDENTIFIER IDENTIFIER SEMI { $$->push_back(StructMember(false, $<string_id>2, $<string_id>3)); }
+        ;
+
+function: IDENTIFIER IDENTIFIER LPAREN RPAREN LBRACE block RBRACE { context->module->functions.push_back(Function($<string_id>1, $<string_id>2, FunctionParameters(), context->module->add_block(*$<block_list>6), context->item_offset, context->take_target_clones())); context->finish_top_level(); }
+        | IDENTIFIER IDENTIFIER LPAREN parameters RPAREN LBRACE block RBRACE { context->module->functions.push_back(Function($<string_id>1, $<string_id>2, context->module->add_list(*$<function_parameters>4), context->module->add_block(*$<block_list>7), context->item_offset, context->take_target_clones())); context->finish_top_level(); }
+        ;
+
+extern: IDENTIFIER IDENTIFIER LPAREN RPAREN SEMI { no_attributes(scanner, context); context->module->extern_functions.push_back(ExternFunction($<string_id>1, $<string_id>2)); context->finish_top_level(); }
+      | IDENTIFIER IDENTIFIER LPAREN parameters RPAREN SEMI { no_attributes(scanner, context); context->module->extern_functions.push_back(ExternFunction($<string_id>1, $<string_id>2, context->module->add_list(*$<function_parameters>4))); context->finish_top_level(); }
       ;
 
-parameters: IDENTIFIER IDENTIFIER { FunctionParameters* parameters = new FunctionParameters(); parameters->push_back({std::make_shared<UnresolvedType>(StringCache::get($<string_id>1)), StringCache::get($<string_id>2)}); $$ = parameters; }
-        | parameters COMMA IDENTIFIER IDENTIFIER { $1->push_back({std::make_shared<UnresolvedType>(StringCache::get($<string_id>3)), StringCache::get($<string_id>4)}); }
+parameters: IDENTIFIER IDENTIFIER { ParseList<FunctionParameter>* parameters = context->create_list<FunctionParameter>(); parameters->push_back({TypeTable::unresolved($<string_id>1), $<string_id>2}); $$ = parameters; }
+        | parameters COMMA IDENTIFIER IDENTIFIER { $1->push_back({TypeTable::unresolved($<string_id>3), $<string_id>4}); }
         ;
 
-block: statement { Block* block = new Block(); block->push_back($<statement_ptr>1); $$ = block; }
-	| block statement { $1->push_back($<statement_ptr>2); }
+block: statement { ParseList<StatementRef>* block = context->create_list<StatementRef>(); block->push_back($<statement_ref>1); $$ = block; }
+	| block statement { $1->push_back($<statement_ref>2); }
 	;
 
-statement: RETURN expression SEMI { $$ = new ReturnStatement($<expression_ptr>2); }
-		| IDENTIFIER IDENTIFIER ASSIGN expression SEMI { $$ = new DeclarationStatement(StringCache::get($<string_id>1), StringCache::get($<string_id>2), $<expression_ptr>4); }
-        | IDENTIFIER ASSIGN expression SEMI { $$ = new AssignmentStatement(StringCache::get($<string_id>1), $<expression_ptr>3); }
-        | IDENTIFIER LPAREN RPAREN SEMI { $$ = new FunctionCallStatement(StringCache::get($<string_id>1)); }
-		| IDENTIFIER LPAREN arguments RPAREN SEMI { $$ = new FunctionCallStatement(StringCache::get($<string_id>1), $<function_arguments>3); }
-		| IF LPAREN expression RPAREN LBRACE block RBRACE { $$ = new IfStatement($<expression_ptr>3, $<block_ptr>6, nullptr); }
-        | IF LPAREN expression RPAREN LBRACE block RBRACE ELSE LBRACE block RBRACE { $$ = new IfStatement($<expression_ptr>3, $<block_ptr>6, $<block_ptr>10); }
+statement: RETURN expression SEMI { $$ = context->module->add_statement(ReturnStatement($<expression_ref>2)); }
+		| IDENTIFIER IDENTIFIER ASSIGN expression SEMI { $$ = context->module->add_statement(DeclarationStatement($<string_id>1, $<string_id>2, $<expression_ref>4)); }
+        | IDENTIFIER ASSIGN expression SEMI { $$ = context->module->add_statement(AssignmentStatement($<string_id>1, $<expression_ref>3)); }
+        | IDENTIFIER LPAREN RPAREN SEMI { $$ = context->module->add_statement(FunctionCallStatement($<string_id>1)); }
+		| IDENTIFIER LPAREN arguments RPAREN SEMI { $$ = context->module->add_statement(FunctionCallStatement($<string_id>1, context->module->add_list(*$<function_arguments>3))); }
+		| IF LPAREN expression RPAREN LBRACE block RBRACE { $$ = context->module->add_statement(IfStatement($<expression_ref>3, context->module->add_block(*$<block_list>6), InvalidBlock)); }
+        | IF LPAREN expression RPAREN LBRACE block RBRACE ELSE LBRACE block RBRACE { $$ = context->module->add_statement(IfStatement($<expression_ref>3, context->module->add_block(*$<block_list>6), context->module->add_block(*$<block_list>10))); }
+        | loop
+        | BREAK SEMI { $$ = context->module->add_statement(JumpStatement(JumpType::Break)); }
+        | CONTINUE SEMI { $$ = context->module->add_statement(JumpStatement(JumpType::Continue)); }
 		;
 
-expression: INTEGER { $$ = new ConstantIntegerExpression($<int_val>1); }
-		| FLOAT {$$ = new ConstantDoubleExpression($<double_val>1); }
-		| IDENTIFIER { $$ = new IdentifierExpression(StringCache::get($<string_id>1)); }
-		| LPAREN expression RPAREN { $$ = $<expression_ptr>2; }
-		| expression ADD expression { $$ = new BinaryOperatorExpression(MathOperator::ADD, $<expression_ptr>1, $<expression_ptr>3); }
-		| expression SUB expression { $$ = new BinaryOperatorExpression(MathOperator::SUB, $<expression_ptr>1, $<expression_ptr>3); }
-		| expression MUL expression { $$ = new BinaryOperatorExpression(MathOperator::MUL, $<expression_ptr>1, $<expression_ptr>3); }
-		| expression DIV expression { $$ = new BinaryOperatorExpression(MathOperator::DIV, $<expression_ptr>1, $<expression_ptr>3); }
-		| expression MOD expression { $$ = new BinaryOperatorExpression(MathOperator::MOD, $<expression_ptr>1, $<expression_ptr>3); }
-		| IDENTIFIER LPAREN RPAREN { $$ = new FunctionCallExpression(StringCache::get($<string_id>1)); }
-		| IDENTIFIER LPAREN arguments RPAREN { $$ = new FunctionCallExpression(StringCache::get($<string_id>1), $<function_arguments>3); }
+loop: WHILE LPAREN expression RPAREN LBRACE block RBRACE { $$ = context->module->add_statement(WhileLoopStatement($<expression_ref>3, context->module->add_block(*$<block_list>6))); }
+        | DO LBRACE block RBRACE WHILE LPAREN expression RPAREN SEMI
+        {
+            WhileLoopStatement loop($<expression_ref>7, context->module->add_block(*$<block_list>3));
+            loop.test_first = false;
+            $$ = context->module->add_statement(std::move(loop));
+        }
+        | FOR LPAREN for_statement SEMI for_condition SEMI for_statement RPAREN LBRACE block RBRACE
+        {
+            WhileLoopStatement loop($<expression_ref>5, context->module->add_block(*$<block_list>10));
+            loop.init = $<statement_ref>3;
+            loop.step = $<statement_ref>7;
+            $$ = context->module->add_statement(std::move(loop));
+        }
+        | AT IDENTIFIER LPAREN INTEGER RPAREN loop { add_loop_hint(scanner, context, $<statement_ref>6, $<string_id>2, $<int_val>4); $$ = $<statement_ref>6; }
+        | AT IDENTIFIER loop { add_loop_hint(scanner, context, $<statement_ref>3, $<string_id>2, LoopHints::any); $$ = $<statement_ref>3; }
+        ;
+
+//Every part of a for loop's header may be left out
+for_statement: %empty { $$ = StatementRef::invalid(); }
+        | IDENTIFIER IDENTIFIER ASSIGN expression { $$ = context->module->add_statement(DeclarationStatement($<string_id>1, $<string_id>2, $<expression_ref>4)); }
+        | IDENTIFIER ASSIGN expression { $$ = context->module->add_statement(AssignmentStatement($<string_id>1, $<expression_ref>3)); }
+        ;
+
+for_condition: %empty { $$ = ExpressionRef::invalid(); }
+        | expression
+        ;
+
+expression: INTEGER { $$ = context->module->add_expression(ConstantIntegerExpression($<int_val>1)); }
+		| FLOAT {$$ = context->module->add_expression(ConstantDoubleExpression($<double_val>1)); }
+		| IDENTIFIER { $$ = context->module->add_expression(IdentifierExpression($<string_id>1)); }
+		| LPAREN expression RPAREN { $$ = $<expression_ref>2; }
+		| expression ADD expression { $$ = context->module->add_expression(BinaryOperatorExpression(MathOperator::ADD, $<expression_ref>1, $<expression_ref>3)); }
+		| expression SUB expression { $$ = context->module->add_expression(BinaryOperatorExpression(MathOperator::SUB, $<expression_ref>1, $<expression_ref>3)); }
+		| expression MUL expression { $$ = context->module->add_expression(BinaryOperatorExpression(MathOperator::MUL, $<expression_ref>1, $<expression_ref>3)); }
+		| expression DIV expression { $$ = context->module->add_expression(BinaryOperatorExpression(MathOperator::DIV, $<expression_ref>1, $<expression_ref>3)); }
+		| expression MOD expression { $$ = context->module->add_expression(BinaryOperatorExpression(MathOperator::MOD, $<expression_ref>1, $<expression_ref>3)); }
+		| expression EQUAL expression { $$ = context->module->add_expression(BinaryOperatorExpression(MathOperator::EQUAL, $<expression_ref>1, $<expression_ref>3)); }
+		| expression NOT_EQUAL expression { $$ = context->module->add_expression(BinaryOperatorExpression(MathOperator::NOT_EQUAL, $<expression_ref>1, $<expression_ref>3)); }
+		| expression LARROW expression { $$ = context->module->add_expression(BinaryOperatorExpression(MathOperator::LESS, $<expression_ref>1, $<expression_ref>3)); }
+		| expression LESS_EQUAL expression { $$ = context->module->add_expression(BinaryOperatorExpression(MathOperator::LESS_EQUAL, $<expression_ref>1, $<expression_ref>3)); }
+		| expression RARROW expression { $$ = context->module->add_expression(BinaryOperatorExpression(MathOperator::GREATER, $<expression_ref>1, $<expression_ref>3)); }
+		| expression GREATER_EQUAL expression { $$ = context->module->add_expression(BinaryOperatorExpression(MathOperator::GREATER_EQUAL, $<expression_ref>1, $<expression_ref>3)); }
+		| IDENTIFIER LPAREN RPAREN { $$ = context->module->add_expression(FunctionCallExpression($<string_id>1)); }
+		| IDENTIFIER LPAREN arguments RPAREN { $$ = context->module->add_expression(FunctionCallExpression($<string_id>1, context->module->add_list(*$<function_arguments>3))); }
 		;
 
-arguments: expression { FunctionArguments* function_arguments = new FunctionArguments(); function_arguments->push_back($<expression_ptr>1); $$ = function_arguments; }
-            | arguments COMMA expression { $1->push_back($<expression_ptr>3); }
+arguments: expression { ParseList<ExpressionRef>* function_arguments = context->create_list<ExpressionRef>(); function_arguments->push_back($<expression_ref>1); $$ = function_arguments; }
+            | arguments COMMA expression { $1->push_back($<expression_ref>3); }
             ;
 %%
+
+unique_ptr<Module> parse_source_file(SourceFile* file)
+{
+    unique_ptr<Module> module = std::make_unique<Module>();
+    if(!parse_source_file(file, module.get(), nullptr))
+    {
+        return nullptr;
+    }
+    return module;
+}
+
+bool parse_source_file(SourceFile* file, Module* module, const TopLevelCallback& top_level_parsed)
+{
+    ParseContext context;
+    context.file = file;
+    context.module = module;
+    context.top_level_parsed = &top_level_parsed;
+
+    void* scanner = lexer_create(file);
+    int result = yyparse(scanner, &context);
+    lexer_destroy(scanner);
+
+    return result == 0 && !context.failed;
+}
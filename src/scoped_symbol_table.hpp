@@ -0,0 +1,141 @@
+#pragma once
+
+#include "containers.hpp"
+#include "string_cache.hpp"
+
+//Maps interned names to whatever is bound to them in the innermost scope that declares them
+//All scopes share one open addressing table, entering a scope is free and leaving it undoes the bindings it made
+//One table is meant to live for a whole function so nested blocks never allocate
+template<typename T>
+class ScopedSymbolTable
+{
+protected:
+    static const StringId empty_key = 0xFFFFFFFF;
+    static const uint32_t unbound = 0;
+
+    //A name keeps its slot once it has one, leaving a scope only unbinds it so no tombstones are needed
+    struct Slot
+    {
+        StringId name = empty_key;
+        uint32_t depth = unbound;
+        T value;
+    };
+
+    //The binding a name had before the current scope shadowed it
+    struct Undo
+    {
+        StringId name;
+        uint32_t depth;
+        T value;
+    };
+
+    vector<Slot> slots;
+    size_t used = 0;
+    vector<Undo> undo_stack;
+    vector<size_t> scope_starts;
+
+    //For --stats, every slot looked at counts as a probe
+    mutable size_t lookup_count = 0;
+    mutable size_t probe_count = 0;
+
+    size_t find_slot(StringId name) const
+    {
+        size_t mask = this->slots.size() - 1;
+        size_t index = (name * 0x9E3779B1u) & mask;
+        this->lookup_count++;
+        this->probe_count++;
+        while(this->slots[index].name != name && this->slots[index].name != empty_key)
+        {
+            index = (index + 1) & mask;
+            this->probe_count++;
+        }
+        return index;
+    };
+
+    void grow()
+    {
+        vector<Slot> old_slots(this->slots.size() * 2);
+        old_slots.swap(this->slots);
+        for(Slot& slot: old_slots)
+        {
+            if(slot.name != empty_key)
+            {
+                this->slots[this->find_slot(slot.name)] = slot;
+            }
+        }
+    };
+
+public:
+    ScopedSymbolTable(): slots(64) {};
+
+    void push_scope()
+    {
+        this->scope_starts.push_back(this->undo_stack.size());
+    };
+
+    void pop_scope()
+    {
+        size_t start = this->scope_starts.back();
+        this->scope_starts.pop_back();
+        while(this->undo_stack.size() > start)
+        {
+            Undo& undo = this->undo_stack.back();
+            Slot& slot = this->slots[this->find_slot(undo.name)];
+            slot.depth = undo.depth;
+            slot.value = undo.value;
+            this->undo_stack.pop_back();
+        }
+    };
+
+    //Returns false if the name is already bound in the current scope
+    bool add(StringId name, const T& value)
+    {
+        if((this->used + 1) * 4 > this->slots.size() * 3)
+        {
+            this->grow();
+        }
+
+        Slot& slot = this->slots[this->find_slot(name)];
+        if(slot.name == empty_key)
+        {
+            slot.name = name;
+            this->used++;
+        }
+
+        uint32_t depth = (uint32_t)this->scope_starts.size();
+        if(slot.depth == depth)
+        {
+            return false;
+        }
+
+        this->undo_stack.push_back({name, slot.depth, slot.value});
+        slot.depth = depth;
+        slot.value = value;
+        return true;
+    };
+
+    //Returns nullptr if the name is not bound in any open scope
+    T* find(StringId name)
+    {
+        Slot& slot = this->slots[this->find_slot(name)];
+        if(slot.name == empty_key || slot.depth == unbound)
+        {
+            return nullptr;
+        }
+        return &slot.value;
+    };
+
+    size_t get_lookup_count() const { return this->lookup_count; };
+    size_t get_probe_count() const { return this->probe_count; };
+
+    //Opens a scope for the lifetime of the guard, so early returns still close it
+    class Scope
+    {
+    protected:
+        ScopedSymbolTable<T>* table;
+
+    public:
+        Scope(ScopedSymbolTable<T>* table): table(table) { this->table->push_scope(); };
+        ~Scope() { this->table->pop_scope(); };
+    };
+};
@@ -0,0 +1,105 @@
+#include "source_manager.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdio.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceFile::SourceFile(const string& path, char* data, size_t size, size_t map_length)
+:path(path), data(data), size(size), map_length(map_length)
+{
+}
+
+SourceFile::~SourceFile()
+{
+    munmap(this->data, this->map_length);
+}
+
+SourceLocation SourceFile::get_location(const char* position)
+{
+    return this->get_location((uint32_t)(position - this->data));
+}
+
+SourceLocation SourceFile::get_location(uint32_t offset)
+{
+    if(this->line_offsets.empty())
+    {
+        this->build_line_offsets();
+    }
+
+    auto line_it = std::upper_bound(this->line_offsets.begin(), this->line_offsets.end(), offset) - 1;
+    SourceLocation location;
+    location.line = (uint32_t)(line_it - this->line_offsets.begin()) + 1;
+    location.column = offset - *line_it + 1;
+    return location;
+}
+
+void SourceFile::build_line_offsets()
+{
+    this->line_offsets.push_back(0);
+
+    const char* position = this->data;
+    const char* end = this->data + this->size;
+    while((position = (const char*)memchr(position, '\n', end - position)) != nullptr)
+    {
+        position++;
+        this->line_offsets.push_back((uint32_t)(position - this->data));
+    }
+}
+
+SourceFile* SourceManager::open(const string& path)
+{
+    int file = ::open(path.c_str(), O_RDONLY);
+    if(file < 0)
+    {
+        printf("Error: cannot open file %s\n", path.c_str());
+        return nullptr;
+    }
+
+    struct stat file_stat;
+    if(fstat(file, &file_stat) != 0 || (uint64_t)file_stat.st_size > UINT32_MAX)
+    {
+        printf("Error: cannot read file %s\n", path.c_str());
+        ::close(file);
+        return nullptr;
+    }
+
+    size_t size = (size_t)file_stat.st_size;
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t map_length = (size + SourceFile::padding + page_size - 1) & ~(page_size - 1);
+
+    //Reserve zeroed memory for the file plus its padding, then map the file over the front of it
+    //The mapping is private so the scanner may write into it without touching the file
+    char* data = (char*)mmap(nullptr, map_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(data == MAP_FAILED)
+    {
+        printf("Error: cannot map file %s\n", path.c_str());
+        ::close(file);
+        return nullptr;
+    }
+
+    if(size > 0)
+    {
+        if(mmap(data, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, file, 0) == MAP_FAILED)
+        {
+            printf("Error: cannot map file %s\n", path.c_str());
+            munmap(data, map_length);
+            ::close(file);
+            return nullptr;
+        }
+        madvise(data, size, MADV_SEQUENTIAL);
+    }
+    ::close(file);
+
+    this->files.push_back(std::make_unique<SourceFile>(path, data, size, map_length));
+    return this->files.back().get();
+}
+
+void SourceManager::close(SourceFile* file)
+{
+    this->files.erase(std::remove_if(this->files.begin(), this->files.end(), [file](const unique_ptr<SourceFile>& open_file) { return open_file.get() == file; }), this->files.end());
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "containers.hpp"
+
+struct SourceLocation
+{
+    uint32_t line;
+    uint32_t column;
+};
+
+//A read only view of one input file, mapped straight into memory
+//The mapping is followed by at least padding zero bytes so the scanners can run over it in place and read whole vectors past the end
+class SourceFile
+{
+public:
+    static const size_t padding = 64;
+
+    SourceFile(const string& path, char* data, size_t size, size_t map_length);
+    ~SourceFile();
+
+    const string& get_path() { return this->path; };
+    char* get_data() { return this->data; };
+    size_t get_size() { return this->size; };
+
+    SourceLocation get_location(const char* position);
+    SourceLocation get_location(uint32_t offset);
+
+protected:
+    string path;
+    char* data;
+    size_t size;
+    size_t map_length;
+
+    //Offset of the first byte of every line, only built once a diagnostic needs it
+    vector<uint32_t> line_offsets;
+    void build_line_offsets();
+};
+
+class SourceManager
+{
+public:
+    SourceFile* open(const string& path);
+
+    //Unmaps a file opened here, anything pointing into it is invalid afterwards
+    void close(SourceFile* file);
+
+protected:
+    vector<unique_ptr<SourceFile>> files;
+};
@@ -0,0 +1,115 @@
+#include "streaming_compiler.hpp"
+
+StreamingCompiler::StreamingCompiler(const string& module_name, Module* module, TimeReport* time_report, CompileStats* stats, SourceFile* debug_source)
+:module(module), time_report(time_report), resolver(time_report, stats), llvm_module(module_name, module, false, time_report, stats, debug_source)
+{
+    this->resolver.begin(module);
+    this->kept_nodes = module->get_mark();
+}
+
+void StreamingCompiler::report(const ResolveError& error)
+{
+    printf("%s", error.message.c_str());
+    this->failed = true;
+}
+
+void StreamingCompiler::top_level_parsed()
+{
+    //The parser has no lists alive between top level items
+    this->module->arena.release();
+
+    //Structs and externs are small and later items refer to them, so their nodes are kept
+    for(; this->struct_count < this->module->structs.size(); this->struct_count++)
+    {
+        Struct& struct_object = this->module->structs[this->struct_count];
+        try
+        {
+            TimeReport::Timer timer(this->time_report, "structs");
+            this->resolver.resolve_struct(struct_object);
+            this->llvm_module.generate_struct(struct_object);
+        }
+        catch(const ResolveError& error)
+        {
+            this->report(error);
+        }
+    }
+
+    for(; this->extern_count < this->module->extern_functions.size(); this->extern_count++)
+    {
+        ExternFunction& function = this->module->extern_functions[this->extern_count];
+        try
+        {
+            TimeReport::Timer timer(this->time_report, "externs");
+            this->resolver.resolve_extern(function);
+            this->llvm_module.generate_extern_function(function);
+        }
+        catch(const ResolveError& error)
+        {
+            this->report(error);
+        }
+    }
+
+    //Streamed functions are removed as soon as they are done, so a new one is always past the deferred ones
+    if(this->module->functions.size() == this->deferred_functions.size())
+    {
+        this->kept_nodes = this->module->get_mark();
+        return;
+    }
+
+    size_t index = this->module->functions.size() - 1;
+    Function& function = this->module->functions[index];
+    llvm::Function* prototype = nullptr;
+    try
+    {
+        {
+            TimeReport::Timer timer(this->time_report, "prototypes");
+            this->resolver.resolve_function(function);
+            prototype = this->llvm_module.generate_function_prototype(function);
+        }
+        {
+            TimeReport::Timer timer(this->time_report, "bodies");
+            this->resolver.resolve_function_body(function);
+        }
+        {
+            TimeReport::Timer timer(this->time_report, "codegen");
+            this->llvm_module.generate_function_body(prototype, function);
+        }
+    }
+    catch(const ResolveError& error)
+    {
+        if(error.missing_function && prototype != nullptr)
+        {
+            //Resolving only writes types onto the nodes, so the body can simply be resolved again later
+            this->deferred_functions.push_back({index, prototype});
+            this->kept_nodes = this->module->get_mark();
+            return;
+        }
+        this->report(error);
+    }
+
+    this->module->functions.pop_back();
+    this->module->release_nodes(this->kept_nodes);
+}
+
+bool StreamingCompiler::finish()
+{
+    for(DeferredFunction& deferred: this->deferred_functions)
+    {
+        Function& function = this->module->functions[deferred.index];
+        try
+        {
+            {
+                TimeReport::Timer timer(this->time_report, "bodies");
+                this->resolver.resolve_function_body(function);
+            }
+            TimeReport::Timer timer(this->time_report, "codegen");
+            this->llvm_module.generate_function_body(deferred.prototype, function);
+        }
+        catch(const ResolveError& error)
+        {
+            this->report(error);
+        }
+    }
+
+    return !this->failed;
+}
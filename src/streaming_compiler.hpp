@@ -0,0 +1,44 @@
+#pragma once
+
+#include "containers.hpp"
+#include "ast/ast_resolver.hpp"
+#include "llvm/llvm_code_gen.hpp"
+
+//Resolves and generates each function as soon as the parser finishes it, then drops its AST nodes
+//So the AST held at once is bounded by the largest function instead of the whole file, the LLVM module still grows until it is compiled
+//A function that calls one that has not been parsed yet keeps its nodes and is finished once the whole file is parsed
+class StreamingCompiler
+{
+public:
+    StreamingCompiler(const string& module_name, Module* module, TimeReport* time_report = nullptr, CompileStats* stats = nullptr, SourceFile* debug_source = nullptr);
+
+    //Called by the parser after every struct, extern and function
+    void top_level_parsed();
+
+    //Finishes the functions that had to wait, returns false if anything had errors
+    bool finish();
+
+    llvmModule& get_llvm_module() { return this->llvm_module; };
+
+protected:
+    struct DeferredFunction
+    {
+        size_t index;
+        llvm::Function* prototype;
+    };
+
+    Module* module;
+    TimeReport* time_report;
+    AstResolver resolver;
+    llvmModule llvm_module;
+    bool failed = false;
+
+    size_t struct_count = 0;
+    size_t extern_count = 0;
+    vector<DeferredFunction> deferred_functions;
+
+    //Everything before this mark belongs to items that are still needed
+    NodeMark kept_nodes;
+
+    void report(const ResolveError& error);
+};
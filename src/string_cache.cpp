@@ -1,27 +1,118 @@
 #include "string_cache.hpp"
 
-vector<string> StringCache::symbols;
+#include <cstring>
+#include <stdio.h>
 
-size_t StringCache::add(string symbol)
+StringCache::Shard StringCache::shards[StringCache::shard_count];
+
+const char* StringCache::Shard::store(const char* data, size_t length)
 {
-    for(size_t i = 0; i < StringCache::symbols.size(); i++)
+    //Symbols are null terminated so they can be handed straight to printf
+    size_t needed = length + 1;
+    char* destination = nullptr;
+
+    if(needed > StringCache::block_size)
     {
-        if(symbol == StringCache::symbols[i])
+        //Oversized symbols get a block of their own, kept in front of the block that still has free space
+        unique_ptr<char[]> oversized(new char[needed]);
+        destination = oversized.get();
+        this->block_bytes += needed;
+        this->blocks.insert(this->blocks.empty() ? this->blocks.end() : this->blocks.end() - 1, std::move(oversized));
+    }
+    else
+    {
+        if(this->block_used + needed > StringCache::block_size)
         {
-            return i;
+            this->blocks.push_back(unique_ptr<char[]>(new char[StringCache::block_size]));
+            this->block_bytes += StringCache::block_size;
+            this->block_used = 0;
         }
+
+        destination = this->blocks.back().get() + this->block_used;
+        this->block_used += needed;
     }
 
-    StringCache::symbols.push_back(symbol);
-    return StringCache::symbols.size() - 1;
+    memcpy(destination, data, length);
+    destination[length] = '\0';
+    return destination;
+}
+
+StringId StringCache::Shard::add(string_view symbol, size_t shard_index)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->lookup_count++;
+
+    auto find_it = this->symbol_map.find(symbol);
+    if(find_it != this->symbol_map.end())
+    {
+        return find_it->second;
+    }
+
+    size_t index = this->symbol_count;
+    size_t chunk = index >> StringCache::chunk_bits;
+    if(chunk >= StringCache::max_chunks)
+    {
+        printf("Error: too many symbols\n");
+        exit(-1);
+    }
+    if(!this->chunks[chunk])
+    {
+        this->chunks[chunk] = unique_ptr<string_view[]>(new string_view[StringCache::chunk_size]);
+    }
+
+    string_view stored_symbol(this->store(symbol.data(), symbol.size()), symbol.size());
+    this->chunks[chunk][index & (StringCache::chunk_size - 1)] = stored_symbol;
+    this->symbol_count++;
+
+    StringId id = (StringId)((index << StringCache::shard_bits) | shard_index);
+    this->symbol_map.emplace(stored_symbol, id);
+    return id;
+}
+
+StringId StringCache::add(const char* data, size_t length)
+{
+    string_view symbol(data, length);
+    size_t shard_index = (std::hash<string_view>()(symbol) >> 16) & (StringCache::shard_count - 1);
+    return StringCache::shards[shard_index].add(symbol, shard_index);
+};
+
+StringId StringCache::add(string_view symbol)
+{
+    return StringCache::add(symbol.data(), symbol.size());
+};
+
+string_view StringCache::get(StringId id)
+{
+    Shard& shard = StringCache::shards[id & (StringCache::shard_count - 1)];
+    size_t index = id >> StringCache::shard_bits;
+    return shard.chunks[index >> StringCache::chunk_bits][index & (StringCache::chunk_size - 1)];
 };
 
-string& StringCache::get(size_t id)
+const char* StringCache::c_str(StringId id)
 {
-    return StringCache::symbols[id];
+    return StringCache::get(id).data();
 };
 
-void StringCache::clear()
+size_t StringCache::size()
 {
-    StringCache::symbols.clear();
-};
\ No newline at end of file
+    size_t count = 0;
+    for(Shard& shard: StringCache::shards)
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        count += shard.symbol_count;
+    }
+    return count;
+};
+
+StringCacheStats StringCache::get_stats()
+{
+    StringCacheStats stats;
+    for(Shard& shard: StringCache::shards)
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        stats.symbols += shard.symbol_count;
+        stats.lookups += shard.lookup_count;
+        stats.bytes += shard.block_bytes;
+    }
+    return stats;
+};
@@ -2,13 +2,61 @@
 
 #include "containers.hpp"
 
+#include <mutex>
+#include <string_view>
+
+using std::string_view;
+
+typedef uint32_t StringId;
+
+struct StringCacheStats
+{
+    size_t symbols = 0;
+    size_t lookups = 0;
+    size_t bytes = 0;
+};
+
+//Interns every identifier the lexers see, the bytes live in an append only arena so the views handed out stay valid for the life of the process
+//Symbols are spread over independently locked shards so files can be lexed on many threads at once
+//The low bits of a StringId select the shard and the rest index into it, so get() never has to lock
 class StringCache
 {
     protected:
-    static vector<string> symbols;
+    static const size_t shard_bits = 4;
+    static const size_t shard_count = 1 << shard_bits;
+    static const size_t block_size = 64 * 1024;
+    static const size_t chunk_bits = 14;
+    static const size_t chunk_size = 1 << chunk_bits;
+    static const size_t max_chunks = 1024;
+
+    struct Shard
+    {
+        std::mutex lock;
+        vector<unique_ptr<char[]>> blocks;
+        size_t block_used = block_size;
+
+        //Bytes of every block, oversized ones included
+        size_t block_bytes = 0;
+        unordered_map<string_view, StringId> symbol_map;
+        size_t symbol_count = 0;
+        size_t lookup_count = 0;
+
+        //Fixed table of fixed size chunks, symbols never move once added
+        unique_ptr<string_view[]> chunks[max_chunks];
+
+        const char* store(const char* data, size_t length);
+        StringId add(string_view symbol, size_t shard_index);
+    };
+
+    static Shard shards[shard_count];
 
     public:
-    static size_t add(string symbol);
-    static string& get(size_t id);
-    static void clear();
-};
\ No newline at end of file
+    static StringId add(const char* data, size_t length);
+    static StringId add(string_view symbol);
+    static string_view get(StringId id);
+    static const char* c_str(StringId id);
+    static size_t size();
+
+    //Totals over every file compiled so far, a lookup that finds an existing symbol is a hit
+    static StringCacheStats get_stats();
+};
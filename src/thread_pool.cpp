@@ -0,0 +1,76 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+    if(thread_count == 0)
+    {
+        thread_count = std::thread::hardware_concurrency();
+        if(thread_count == 0)
+        {
+            thread_count = 1;
+        }
+    }
+
+    this->threads.reserve(thread_count);
+    for(size_t i = 0; i < thread_count; i++)
+    {
+        this->threads.emplace_back(&ThreadPool::worker, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(this->jobs_lock);
+        this->stopping = true;
+    }
+    this->jobs_added.notify_all();
+
+    for(std::thread& thread: this->threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::add_job(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> guard(this->jobs_lock);
+        this->jobs.push_back(std::move(job));
+    }
+    this->jobs_added.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> guard(this->jobs_lock);
+    this->jobs_finished.wait(guard, [this]() { return this->jobs.empty() && this->running_jobs == 0; });
+}
+
+void ThreadPool::worker()
+{
+    while(true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> guard(this->jobs_lock);
+            this->jobs_added.wait(guard, [this]() { return this->stopping || !this->jobs.empty(); });
+            if(this->jobs.empty())
+            {
+                return;
+            }
+
+            job = std::move(this->jobs.front());
+            this->jobs.pop_front();
+            this->running_jobs++;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> guard(this->jobs_lock);
+            this->running_jobs--;
+        }
+        this->jobs_finished.notify_all();
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "containers.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//Fixed set of worker threads pulling jobs off one shared queue
+class ThreadPool
+{
+public:
+    //A thread_count of 0 uses one thread per hardware thread
+    ThreadPool(size_t thread_count);
+    ~ThreadPool();
+
+    size_t get_thread_count() { return this->threads.size(); };
+
+    void add_job(std::function<void()> job);
+
+    //Blocks until every job added so far has finished
+    void wait();
+
+protected:
+    vector<std::thread> threads;
+    std::deque<std::function<void()>> jobs;
+    std::mutex jobs_lock;
+    std::condition_variable jobs_added;
+    std::condition_variable jobs_finished;
+    size_t running_jobs = 0;
+    bool stopping = false;
+
+    void worker();
+};
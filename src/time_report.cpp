@@ -0,0 +1,197 @@
+#include "time_report.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <time.h>
+
+//Phases with more children than this, like per function codegen, only list their slowest ones in the text report
+static const size_t max_printed_children = 10;
+
+static void print_json_string(FILE* out, string_view text)
+{
+    fputc('"', out);
+    for(char character: text)
+    {
+        if(character == '"' || character == '\\')
+        {
+            fputc('\\', out);
+            fputc(character, out);
+        }
+        else if((unsigned char)character < 0x20)
+        {
+            fprintf(out, "\\u%04x", character);
+        }
+        else
+        {
+            fputc(character, out);
+        }
+    }
+    fputc('"', out);
+}
+
+TimeReport::TimeReport(const string& file_name)
+:file_name(file_name)
+{
+    Entry root_entry;
+    root_entry.name = "total";
+    root_entry.parent = root;
+    this->entries.push_back(root_entry);
+}
+
+double TimeReport::get_wall_time()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double TimeReport::get_cpu_time()
+{
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+size_t TimeReport::get_entry(size_t parent, string_view name)
+{
+    string key = std::to_string(parent);
+    key += '/';
+    key += name;
+
+    auto find_it = this->entry_map.find(key);
+    if(find_it != this->entry_map.end())
+    {
+        return find_it->second;
+    }
+
+    Entry entry;
+    entry.name = string(name);
+    entry.parent = parent;
+    size_t index = this->entries.size();
+    this->entries.push_back(entry);
+    this->entries[parent].children.push_back(index);
+    this->entry_map[key] = index;
+    return index;
+}
+
+TimeReport::Timer::Timer(TimeReport* report, string_view name)
+:report(report)
+{
+    if(this->report == nullptr)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(this->report->lock);
+        this->parent = this->report->current;
+        this->entry = this->report->get_entry(this->parent, name);
+        this->report->current = this->entry;
+    }
+    this->wall_start = TimeReport::get_wall_time();
+    this->cpu_start = TimeReport::get_cpu_time();
+}
+
+TimeReport::Timer::~Timer()
+{
+    if(this->report == nullptr)
+    {
+        return;
+    }
+
+    double wall = TimeReport::get_wall_time() - this->wall_start;
+    double cpu = TimeReport::get_cpu_time() - this->cpu_start;
+
+    std::lock_guard<std::mutex> guard(this->report->lock);
+    Entry& entry = this->report->entries[this->entry];
+    entry.wall += wall;
+    entry.cpu += cpu;
+    this->report->current = this->parent;
+
+    //The root has no timer of its own, it is the sum of the top level phases
+    if(this->parent == root)
+    {
+        this->report->entries[root].wall += wall;
+        this->report->entries[root].cpu += cpu;
+    }
+}
+
+void TimeReport::add(string_view name, double wall, double cpu)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    Entry& entry = this->entries[this->get_entry(this->current, name)];
+    entry.wall += wall;
+    entry.cpu += cpu;
+}
+
+void TimeReport::set_llvm_timings(const string& text, const string& json)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->llvm_text = text;
+    this->llvm_json = json;
+}
+
+void TimeReport::print_entry(FILE* out, size_t entry, size_t depth)
+{
+    const Entry& node = this->entries[entry];
+    fprintf(out, "%10.4f %10.4f  %*s%s\n", node.wall, node.cpu, (int)(depth * 2), "", node.name.c_str());
+
+    vector<size_t> children = node.children;
+    size_t hidden = 0;
+    if(children.size() > max_printed_children)
+    {
+        std::sort(children.begin(), children.end(), [this](size_t a, size_t b) { return this->entries[a].wall > this->entries[b].wall; });
+        hidden = children.size() - max_printed_children;
+        children.resize(max_printed_children);
+    }
+
+    for(size_t child: children)
+    {
+        this->print_entry(out, child, depth + 1);
+    }
+
+    if(hidden != 0)
+    {
+        fprintf(out, "%10s %10s  %*s... %zu more\n", "", "", (int)((depth + 1) * 2), "", hidden);
+    }
+}
+
+void TimeReport::print(FILE* out)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    fprintf(out, "===== Time report: %s =====\n", this->file_name.c_str());
+    fprintf(out, "%10s %10s  %s\n", "Wall (s)", "CPU (s)", "Phase");
+    this->print_entry(out, root, 0);
+    if(!this->llvm_text.empty())
+    {
+        fprintf(out, "%s", this->llvm_text.c_str());
+    }
+    fprintf(out, "\n");
+}
+
+void TimeReport::print_entry_json(FILE* out, size_t entry, size_t depth)
+{
+    const Entry& node = this->entries[entry];
+    fprintf(out, "%*s{\"name\": ", (int)(depth * 2), "");
+    print_json_string(out, node.name);
+    fprintf(out, ", \"wall\": %.6f, \"cpu\": %.6f", node.wall, node.cpu);
+    if(!node.children.empty())
+    {
+        fprintf(out, ", \"children\": [\n");
+        for(size_t i = 0; i < node.children.size(); i++)
+        {
+            this->print_entry_json(out, node.children[i], depth + 1);
+            fprintf(out, i + 1 < node.children.size() ? ",\n" : "\n");
+        }
+        fprintf(out, "%*s]", (int)(depth * 2), "");
+    }
+    fprintf(out, "}");
+}
+
+void TimeReport::print_json(FILE* out)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    fprintf(out, "{\"file\": ");
+    print_json_string(out, this->file_name);
+    fprintf(out, ",\n\"phases\":\n");
+    this->print_entry_json(out, root, 0);
+    fprintf(out, ",\n\"llvm\": {\n%s\n}}", this->llvm_json.c_str());
+}
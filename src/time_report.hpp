@@ -0,0 +1,71 @@
+#pragma once
+
+#include "containers.hpp"
+
+#include <mutex>
+#include <stdio.h>
+#include <string_view>
+
+using std::string_view;
+
+//Wall and CPU time of every phase of one file for --time-report
+//Phases nest, timing a name that is already open under the same parent adds to it so phases run per item still show up once
+class TimeReport
+{
+public:
+    TimeReport(const string& file_name);
+
+    //Times its own lifetime as a child of the innermost open timer, does nothing without a report
+    class Timer
+    {
+    public:
+        Timer(TimeReport* report, string_view name);
+        ~Timer();
+
+    protected:
+        TimeReport* report;
+        size_t entry;
+        size_t parent;
+        double wall_start;
+        double cpu_start;
+    };
+
+    //Adds time measured elsewhere, such as on worker threads, as a child of the innermost open timer
+    void add(string_view name, double wall, double cpu);
+
+    //LLVM keeps its own pass timers, compile() hands over their report in both forms
+    void set_llvm_timings(const string& text, const string& json);
+
+    void print(FILE* out);
+    void print_json(FILE* out);
+
+    static double get_wall_time();
+
+    //CPU time of the calling thread, so files compiled in parallel do not count each other
+    static double get_cpu_time();
+
+protected:
+    struct Entry
+    {
+        string name;
+        size_t parent;
+        double wall = 0.0;
+        double cpu = 0.0;
+        vector<size_t> children;
+    };
+
+    static const size_t root = 0;
+
+    string file_name;
+    std::mutex lock;
+    vector<Entry> entries;
+    unordered_map<string, size_t> entry_map;
+    size_t current = root;
+
+    string llvm_text;
+    string llvm_json;
+
+    size_t get_entry(size_t parent, string_view name);
+    void print_entry(FILE* out, size_t entry, size_t depth);
+    void print_entry_json(FILE* out, size_t entry, size_t depth);
+};